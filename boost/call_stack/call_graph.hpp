@@ -0,0 +1,300 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_CALL_GRAPH_HPP)
+#define BOOST_CALL_STACK_CALL_GRAPH_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Caller/callee graph of functions, gprof-style, built from call stacks as
+ * they are added (e.g. profiler samples).
+ *
+ * Frames are folded to functions by name: the return addresses of one
+ * function merge.  For each function: its self cost (the samples where it
+ * is the innermost frame) and its total cost (the samples where it is
+ * anywhere); for each caller to callee edge: the cost of the samples where
+ * the caller calls the callee.  A sample counts once per function and per
+ * edge, recursion notwithstanding.  Costs are \ref sample_value "count and
+ * weight" pairs.
+ *
+ * Each distinct address is resolved once, through a \ref symbol_cache.  Not
+ * thread-safe.
+ *
+ * @tparam AddrResolver    See \ref symbol_resolver
+ */
+template < typename AddrResolver >
+class call_graph : private boost::noncopyable
+{
+public:
+
+    typedef AddrResolver                                 symbol_resolver_type;
+    typedef std::size_t                                  function_id;
+    typedef std::pair< function_id, function_id >        edge_type;    ///< caller, callee
+    typedef boost::unordered_map< edge_type
+                                , sample_value
+                                , boost::hash<edge_type> >  edges_type;
+
+    struct function_type
+    {
+        std::string   name;
+        sample_value  self;
+        sample_value  total;
+    };
+
+    call_graph() : _stamp(0) {}
+
+    /**
+     * Add a sample.  Empty stacks are skipped.
+     */
+    template < typename CallStack >
+    void add(const CallStack& stack, boost::uint64_t count = 1, boost::uint64_t weight = 0)
+    {
+        if (stack.empty())
+        {
+            return;
+        }
+        const sample_value value(count, weight);
+        ++_stamp;
+
+        _ids.clear();
+        for (typename CallStack::const_iterator frm = stack.begin(); frm != stack.end(); ++frm)
+        {
+            _ids.push_back(_function(frm->addr()));
+        }
+
+        _functions[_ids.front()].self += value;
+        for (std::size_t i = 0; i < _ids.size(); ++i)
+        {
+            if (_stamps[_ids[i]] != _stamp)
+            {
+                _stamps[_ids[i]] = _stamp;
+                _functions[_ids[i]].total += value;
+            }
+        }
+
+        _seen_edges.clear();
+        for (std::size_t i = 1; i < _ids.size(); ++i)
+        {
+            const edge_type edge(_ids[i], _ids[i - 1]);
+            if (std::find(_seen_edges.begin(), _seen_edges.end(), edge) == _seen_edges.end())
+            {
+                _seen_edges.push_back(edge);
+                _edges[edge] += value;
+            }
+        }
+    }
+
+    /**
+     * Add all the samples of a profile.
+     */
+    template < typename CallStack >
+    void add(const stack_profile<CallStack>& profile)
+    {
+        typedef typename stack_profile<CallStack>::const_iterator  const_iterator;
+        for (const_iterator it = profile.begin(); it != profile.end(); ++it)
+        {
+            add(it->first, it->second.count, it->second.weight);
+        }
+    }
+
+    const std::vector<function_type>& functions() const noexcept { return _functions; }
+    const edges_type&                 edges()     const noexcept { return _edges; }
+
+    /**
+     * @return the id of the function named name, or functions().size().
+     */
+    function_id find(const std::string& name) const
+    {
+        typename names_type::const_iterator it = _names.find(name);
+        return it != _names.end() ? it->second : _functions.size();
+    }
+
+    /**
+     * @return the cost of the calls from caller to callee.
+     */
+    sample_value edge(function_id caller, function_id callee) const
+    {
+        typename edges_type::const_iterator it = _edges.find(edge_type(caller, callee));
+        return it != _edges.end() ? it->second : sample_value();
+    }
+
+    /**
+     * Write the graph, gprof-style: a block per function, by decreasing
+     * total cost, with its callers above and its callees below.
+     *
+     * @param weights Write the weights rather than the counts.
+     */
+    void write(std::ostream& os, bool weights = false) const
+    {
+        std::vector<function_id> order(_functions.size());
+        for (function_id i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), by_total(_functions, weights));
+
+        std::vector< std::vector<edge_type> > callers(_functions.size()), callees(_functions.size());
+        for (typename edges_type::const_iterator it = _edges.begin(); it != _edges.end(); ++it)
+        {
+            callers[it->first.second].push_back(it->first);
+            callees[it->first.first].push_back(it->first);
+        }
+
+        char line[64];
+        std::snprintf(line, sizeof(line), "%12s %12s  ", "total", "self");
+        os << line << "function\n";
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            const function_id id = order[i];
+            os << "\n";
+            _write_edges(os, callers[id], true, weights);
+            std::snprintf(line, sizeof(line), "%12llu %12llu  ", _cost(_functions[id].total, weights), _cost(_functions[id].self, weights));
+            os << line << _functions[id].name << "\n";
+            _write_edges(os, callees[id], false, weights);
+        }
+        os << std::flush;
+    }
+
+    void clear()
+    {
+        _functions.clear();
+        _stamps.clear();
+        _names.clear();
+        _addresses.clear();
+        _edges.clear();
+        _symbols.clear();
+    }
+
+private:
+
+    typedef boost::unordered_map< std::string, function_id >    names_type;
+    typedef boost::unordered_map< address_type
+                                , function_id
+                                , boost::hash<address_type> >  addresses_type;
+
+    struct by_total
+    {
+        const std::vector<function_type>&  functions;
+        bool                               weights;
+
+        by_total(const std::vector<function_type>& f, bool w) : functions(f), weights(w) {}
+
+        bool operator()(function_id left, function_id right) const
+        {
+            return _cost(functions[left].total, weights) > _cost(functions[right].total, weights);
+        }
+    };
+
+    static unsigned long long _cost(const sample_value& value, bool weights)
+    {
+        return static_cast<unsigned long long>(weights ? value.weight : value.count);
+    }
+
+    function_id _function(const address_type& addr)
+    {
+        typename addresses_type::const_iterator it = _addresses.find(addr);
+        if (it != _addresses.end())
+        {
+            return it->second;
+        }
+
+        const symbol_resolver_type& sym = _symbols.resolve(addr);
+        std::string name(sym.demangled_name());
+        if (name == "??")
+        {
+            // Unknown frames do not merge: keep their address
+            const char* binary = sym.binary_file();
+            const char* slash  = std::strrchr(binary, '/');
+            char hex[32];
+            std::snprintf(hex, sizeof(hex), "0x%lx", static_cast<unsigned long>(reinterpret_cast<std::size_t>(addr)));
+            name = (std::strcmp(binary, "??") != 0) ? std::string("[") + (slash ? slash + 1 : binary) + "] " + hex
+                                                     : std::string("[unknown] ") + hex;
+        }
+
+        typename names_type::const_iterator nit = _names.find(name);
+        if (nit == _names.end())
+        {
+            function_type fn;
+            fn.name = name;
+            _functions.push_back(fn);
+            _stamps.push_back(0);
+            nit = _names.insert(typename names_type::value_type(name, _functions.size() - 1)).first;
+        }
+        return _addresses.insert(typename addresses_type::value_type(addr, nit->second)).first->second;
+    }
+
+    void _write_edges(std::ostream& os, std::vector<edge_type>& edges, bool callers, bool weights) const
+    {
+        std::sort(edges.begin(), edges.end(), by_edge(_edges, weights));
+        char line[64];
+        for (std::size_t i = 0; i < edges.size(); ++i)
+        {
+            std::snprintf(line, sizeof(line), "%12llu %12s  ", _cost(_edges.find(edges[i])->second, weights), "");
+            os << line << (callers ? "  <- " : "  -> ")
+               << _functions[callers ? edges[i].first : edges[i].second].name << "\n";
+        }
+    }
+
+    struct by_edge
+    {
+        const edges_type&  edges;
+        bool               weights;
+
+        by_edge(const edges_type& e, bool w) : edges(e), weights(w) {}
+
+        bool operator()(const edge_type& left, const edge_type& right) const
+        {
+            return _cost(edges.find(left)->second, weights) > _cost(edges.find(right)->second, weights);
+        }
+    };
+
+private:
+
+    std::vector<function_type>              _functions;
+    std::vector<boost::uint64_t>            _stamps;       ///< last sample counted in, by function
+    boost::uint64_t                         _stamp;
+    names_type                              _names;
+    addresses_type                          _addresses;
+    edges_type                              _edges;
+    symbol_cache< symbol_resolver_type >    _symbols;
+
+    std::vector<function_id>                _ids;          ///< of the sample being added
+    std::vector<edge_type>                  _seen_edges;   ///< of the sample being added
+}; //call_graph
+
+
+typedef call_graph< default_symbol_resolver >  default_call_graph;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_CALL_GRAPH_HPP)
@@ -41,6 +41,8 @@
                                                  - collection of call_frame_impl         - a collection of boost::call_stack::call_frame
                                                                                      * boost::call_stack::call_stack_info <Stack, SymResolver, FrameFormatter>
                                                                                          - a collection of boost::call_stack::call_frame_info <SymResolver, FrameFormatter>
+                                                                                     * boost::call_stack::resolved_call_stack_info <Stack, SymResolver, FrameFormatter>
+                                                                                         - symbols resolved once, a collection of boost::call_stack::resolved_call_frame_info
 
     ---------------------------------------------------------------------------------------------
     Platform Specific                        Platform Independent                    Library User
@@ -82,6 +84,9 @@ typedef call_stack<default_max_depth>  default_stack;
 typedef call_stack_info< default_stack, 
                          default_symbol_resolver,
                          default_call_frame_formatter >  default_call_stack_info;
+typedef resolved_call_stack_info< default_stack, 
+                                  default_symbol_resolver,
+                                  default_call_frame_formatter >  default_resolved_call_stack_info;
 
 
 /**
@@ -0,0 +1,347 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_CONTENTION_PROFILER_HPP)
+#define BOOST_CALL_STACK_CONTENTION_PROFILER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Lock contention profiler: aggregates the time threads wait for the
+ * \ref basic_profiled_mutex "profiled mutexes" by the stack of the waiter
+ * and by the stack of the holder it waited for.
+ *
+ * Uncontended acquisitions are only counted.  A contended acquisition is
+ * timed; the stack of the waiter is captured if it waited at least
+ * threshold_ns, or if it is the sample_every-th contended acquisition.
+ * It is captured when the waiter releases the mutex, once released: the
+ * profiler does not lengthen the critical sections it measures.
+ * When releasing a mutex other threads are waiting for, the holder captures
+ * its own stack under the same conditions, for the time it made them wait.
+ *
+ * GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_contention_profiler
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+
+    struct stats_type
+    {
+        boost::uint64_t  acquisitions;
+        boost::uint64_t  contended;
+        boost::uint64_t  wait_ns;
+        boost::uint64_t  hold_ns;
+    };
+
+    /**
+     * Start profiling.
+     * @param threshold_ns Waits at least this long are captured.
+     * @param sample_every Also capture one contended acquisition in
+     *                     sample_every, whatever its wait; 0: never.
+     */
+    static void start(boost::uint64_t threshold_ns = 1000000, boost::uint32_t sample_every = 100)
+    {
+        state_type& st = state();
+        st.threshold_ns = threshold_ns;
+        st.sample_every = sample_every;
+        st.started      = true;
+    }
+
+    static void stop()
+    {
+        state().started = false;
+    }
+
+    static bool running()
+    {
+        return state().started.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * @return the captured waits, by stack of the waiter: count is the
+     * number of waits, weight their time in nanoseconds.
+     */
+    static profile_type waiter_profile()
+    {
+        return _profile(state().waiters);
+    }
+
+    /**
+     * @return the captured waits, by stack of the holder that released the
+     * mutex waited for: count is the number of releases, weight the time
+     * the waiters spent waiting, in nanoseconds.
+     */
+    static profile_type holder_profile()
+    {
+        return _profile(state().holders);
+    }
+
+    /**
+     * @return the totals since start() or clear(), captured or not.
+     */
+    static stats_type stats()
+    {
+        const state_type& st = state();
+        stats_type ret;
+        ret.acquisitions = st.acquisitions.load();
+        ret.contended    = st.contended.load();
+        ret.wait_ns      = st.wait_ns.load();
+        ret.hold_ns      = st.hold_ns.load();
+        return ret;
+    }
+
+    static void clear()
+    {
+        state_type& st = state();
+        st.acquisitions = 0;
+        st.contended    = 0;
+        st.wait_ns      = 0;
+        st.hold_ns      = 0;
+        boost::mutex::scoped_lock lock(st.mutex);
+        st.waiters.clear();
+        st.holders.clear();
+    }
+
+    /*
+     * Called by the mutexes.
+     */
+
+    static void on_acquired()
+    {
+        ++state().acquisitions;
+    }
+
+    static void on_contended(boost::uint64_t wait_ns)
+    {
+        state_type& st = state();
+        ++st.acquisitions;
+        const boost::uint64_t nth = ++st.contended;
+        st.wait_ns += wait_ns;
+        if (_capture(st, wait_ns, nth))
+        {
+            _record(st.waiters, wait_ns);
+        }
+    }
+
+    static void on_released(boost::uint64_t hold_ns, boost::uint64_t blocked_ns)
+    {
+        state_type& st = state();
+        st.hold_ns += hold_ns;
+        if (blocked_ns && _capture(st, blocked_ns, st.contended.load(boost::memory_order_relaxed)))
+        {
+            _record(st.holders, blocked_ns);
+        }
+    }
+
+private:
+
+    typedef boost::unordered_map< stack_id_type, sample_value >  by_stack_type;
+
+    struct state_type
+    {
+        boost::atomic<bool>             started;
+        boost::uint64_t                 threshold_ns;
+        boost::uint32_t                 sample_every;
+
+        boost::atomic<boost::uint64_t>  acquisitions;
+        boost::atomic<boost::uint64_t>  contended;
+        boost::atomic<boost::uint64_t>  wait_ns;
+        boost::atomic<boost::uint64_t>  hold_ns;
+
+        depot_type                      depot;
+        boost::mutex                    mutex;     ///< guards waiters and holders
+        by_stack_type                   waiters;
+        by_stack_type                   holders;
+
+        state_type()
+            : started(false), threshold_ns(0), sample_every(0)
+            , acquisitions(0), contended(0), wait_ns(0), hold_ns(0)
+        {}
+    };
+
+    /*
+     * Never destroyed: mutexes can be used until the very end of the process.
+     */
+    static state_type& state()
+    {
+        static state_type* st = new state_type();
+        return *st;
+    }
+
+    static bool _capture(const state_type& st, boost::uint64_t wait_ns, boost::uint64_t nth)
+    {
+        return wait_ns >= st.threshold_ns || (st.sample_every && nth % st.sample_every == 0);
+    }
+
+    static void _record(by_stack_type& by_stack, boost::uint64_t wait_ns)
+    {
+        state_type& st = state();
+        const stack_id_type id = st.depot.capture();
+        boost::mutex::scoped_lock lock(st.mutex);
+        by_stack[id] += sample_value(1, wait_ns);
+    }
+
+    static profile_type _profile(const by_stack_type& by_stack)
+    {
+        state_type& st = state();
+        profile_type ret;
+        boost::mutex::scoped_lock lock(st.mutex);
+        for (typename by_stack_type::const_iterator it = by_stack.begin(); it != by_stack.end(); ++it)
+        {
+            ret.add(st.depot.get(it->first), it->second);
+        }
+        return ret;
+    }
+}; //basic_contention_profiler
+
+
+/**
+ * A mutex reporting its contention to \ref basic_contention_profiler while
+ * it runs; otherwise it costs a flag test per lock().  Lockable: use it
+ * with boost::lock_guard, boost::unique_lock, std::lock_guard...
+ *
+ * @tparam Mutex           The mutex wrapped: boost::mutex, std::mutex... with
+ *                         lock(), try_lock() and unlock().
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename Mutex, typename CallStack >
+class basic_profiled_mutex : private boost::noncopyable
+{
+public:
+
+    typedef Mutex                                   mutex_type;
+    typedef basic_contention_profiler< CallStack >  profiler_type;
+
+    basic_profiled_mutex()
+        : _waiters(0)
+        , _wait_start_sum(0)
+        , _hold_start(0)
+        , _wait_ns(0)
+    {}
+
+    void lock()
+    {
+        if (!profiler_type::running())
+        {
+            _mutex.lock();
+            _hold_start = 0;
+            _wait_ns    = 0;
+            return;
+        }
+
+        if (_mutex.try_lock())
+        {
+            profiler_type::on_acquired();
+            _hold_start = detail::monotonic_ns();
+            _wait_ns    = 0;
+            return;
+        }
+
+        // Let the holder know how long we have been waiting
+        const boost::uint64_t start = detail::monotonic_ns();
+        ++_waiters;
+        _wait_start_sum += start;
+        _mutex.lock();
+        _wait_start_sum -= start;
+        --_waiters;
+
+        // Reported by unlock(), not to capture a stack while holding it
+        _hold_start = detail::monotonic_ns();
+        _wait_ns    = _hold_start - start;
+    }
+
+    bool try_lock()
+    {
+        if (!_mutex.try_lock())
+        {
+            return false;
+        }
+        _hold_start = profiler_type::running() ? detail::monotonic_ns() : 0;
+        _wait_ns    = 0;
+        return true;
+    }
+
+    void unlock()
+    {
+        if (!_hold_start)
+        {
+            _mutex.unlock();
+            return;
+        }
+
+        const boost::uint64_t now     = detail::monotonic_ns();
+        const boost::uint64_t hold_ns = now - _hold_start;
+        const boost::uint64_t wait_ns = _wait_ns;
+        const boost::uint32_t waiters = _waiters.load();
+        boost::uint64_t blocked_ns = 0;
+        if (waiters)
+        {
+            // What the waiters waited for, but not before this hold
+            const boost::uint64_t waited = waiters * now - _wait_start_sum.load();
+            const boost::uint64_t held   = waiters * hold_ns;
+            blocked_ns = waited < held ? waited : held;
+        }
+        _mutex.unlock();
+        if (wait_ns)
+        {
+            profiler_type::on_contended(wait_ns);
+        }
+        profiler_type::on_released(hold_ns, blocked_ns);
+    }
+
+    mutex_type&       native()       noexcept { return _mutex; }
+    const mutex_type& native() const noexcept { return _mutex; }
+
+private:
+
+    mutex_type                      _mutex;
+    boost::atomic<boost::uint32_t>  _waiters;
+    boost::atomic<boost::uint64_t>  _wait_start_sum;
+    boost::uint64_t                 _hold_start;   ///< 0: not timed; guarded by _mutex
+    boost::uint64_t                 _wait_ns;      ///< before this hold; guarded by _mutex
+}; //basic_profiled_mutex
+
+
+typedef basic_contention_profiler< default_stack >               default_contention_profiler;
+typedef basic_profiled_mutex< boost::mutex, default_stack >      default_profiled_mutex;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_CONTENTION_PROFILER_HPP)
@@ -0,0 +1,74 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_CRASH_HANDLER_HPP)
+#define BOOST_CALL_STACK_CRASH_HANDLER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/crash_handler.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+
+namespace boost { namespace call_stack {
+
+/**
+ *  Install a handler for the fatal signals (SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+ *  SIGABRT and SIGTRAP) that writes the call stack of the crashing thread to
+ *  a file descriptor, then lets the previous disposition of the signal run.
+ *
+ *  The handler is async-signal-safe: it does not allocate, take locks nor
+ *  resolve symbols.  Each frame is written as a raw address plus the binary
+ *  it belongs to and the offset within it (feed these to addr2line(1)).  The
+ *  unwinder is warmed up and the list of loaded binaries is taken here; see
+ *  \ref refresh_crash_handler_modules.  An alternate signal stack is set up
+ *  for the calling thread so that stack overflows are reported too.
+ *
+ *  Calling it again only changes the file descriptor.
+ *
+ *  @param fd where to write; must stay open.
+ *  @return true if successful.
+ */
+inline
+bool install_crash_handler(int fd = STDERR_FILENO)
+{
+    return boost::call_stack::detail::crash_handler::install(fd);
+}
+
+/**
+ *  Restore the signal dispositions found by \ref install_crash_handler.
+ *  @return true if successful.
+ */
+inline
+bool uninstall_crash_handler()
+{
+    return boost::call_stack::detail::crash_handler::uninstall();
+}
+
+/**
+ *  Refresh the list of loaded binaries used by the crash handler, e.g.
+ *  after loading a module with dlopen(3).  Not async-signal-safe.
+ */
+inline
+void refresh_crash_handler_modules()
+{
+    boost::call_stack::detail::crash_handler::refresh_modules();
+}
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_CRASH_HANDLER_HPP)
@@ -25,6 +25,8 @@
 #include <boost/type_traits.hpp>
 #include <boost/static_assert.hpp>
 
+#include <algorithm>
+
 
 /*
  *
@@ -107,8 +109,9 @@ public:
         return _stack.at(idx);
     }
 
-    bool operator ==(const call_stack_impl& other) const { return _depth == other._depth && _stack == other._stack; }
-    bool operator !=(const call_stack_impl& other) const { return _depth != other._depth || _stack != other._stack; }
+    // Slots past the depth are leftovers of earlier captures: not compared
+    bool operator ==(const call_stack_impl& other) const { return _depth == other._depth && std::equal(begin(), end(), other.begin()); }
+    bool operator !=(const call_stack_impl& other) const { return !(*this == other); }
 
     void swap(call_stack_impl& other) noexcept
     {
@@ -124,6 +127,29 @@ public:
         return _depth;
     }
 
+    depth_type get_stack(const context_type& ctx)
+    {
+        _depth =  detail::get_stack(_stack, ctx);
+        BOOST_ASSERT(_depth <= MaxDepth);
+        return _depth;
+    }
+
+    depth_type assign(const address_type* addrs, std::size_t count)
+    {
+        const depth_type old = _depth;
+        _depth = (count < MaxDepth) ? count : MaxDepth;
+        for (depth_type i = 0; i < _depth; ++i)
+        {
+            _stack[i] = call_frame_impl(addrs[i]);
+        }
+        // A reused stack is as a fresh one past the depth
+        for (depth_type i = _depth; i < old; ++i)
+        {
+            _stack[i] = call_frame_impl();
+        }
+        return _depth;
+    }
+
 private:
 
     stack_type         _stack;
@@ -0,0 +1,348 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_CRASH_HANDLER_HPP)
+#define BOOST_CALL_STACK_GNU_CRASH_HANDLER_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/symbol.hpp>
+#include <boost/call_stack/detail/gnu/frame.hpp>
+#include <boost/call_stack/detail/gnu/stack.hpp>
+
+#include <boost/static_assert.hpp>
+#include <boost/assert.hpp>
+#include <boost/array.hpp>
+
+#include <link.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <execinfo.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+
+
+/*
+ * Everything reachable from the signal handler must be async-signal-safe:
+ * no allocations, no locks, no stdio.  The state is a POD with static
+ * storage, set up at install time.
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class crash_handler
+{
+public:
+
+    static const std::size_t max_depth        = 64;
+    static const std::size_t max_modules      = 256;
+    static const std::size_t max_module_name  = 256;
+    static const std::size_t alt_stack_size   = 64 * 1024;
+
+    /**
+     * @return true if successful.
+     */
+    static bool install(int fd)
+    {
+        state_type& st = state();
+        if (st.installed)
+        {
+            st.fd = fd;
+            return true;
+        }
+
+        st.fd = fd;
+        __atomic_store_n(&st.in_handler, idle, __ATOMIC_RELEASE);
+
+        // backtrace(3) loads libgcc_s on first use: not something to do
+        // from a signal handler.
+        address_type warmup[2];
+        ::backtrace(warmup, 2);
+
+        refresh_modules();
+
+        // Survive stack overflows, at least on the installing thread.
+        stack_t ss;
+        std::memset(&ss, 0, sizeof(ss));
+        ss.ss_sp    = st.alt_stack;
+        ss.ss_size  = sizeof(st.alt_stack);
+        ss.ss_flags = 0;
+        ::sigaltstack(&ss, nullptr);
+
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &crash_handler::on_signal;
+        sa.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+        ::sigemptyset(&sa.sa_mask);
+
+        bool ret = true;
+        for (std::size_t i = 0; i < signal_count; ++i)
+        {
+            ret = (::sigaction(signals()[i].signo, &sa, &st.old_actions[i]) == 0) && ret;
+        }
+
+        st.installed = 1;
+        return ret;
+    }
+
+    /**
+     * @return true if successful.
+     */
+    static bool uninstall()
+    {
+        state_type& st = state();
+        if (!st.installed)
+        {
+            return true;
+        }
+
+        bool ret = true;
+        for (std::size_t i = 0; i < signal_count; ++i)
+        {
+            ret = (::sigaction(signals()[i].signo, &st.old_actions[i], nullptr) == 0) && ret;
+        }
+
+        st.installed = 0;
+        return ret;
+    }
+
+    /**
+     * Snapshot the loaded modules (executable and shared libraries) so that
+     * the handler can print module-relative offsets without calling into
+     * the dynamic loader.  Call again after dlopen(3).
+     */
+    static void refresh_modules()
+    {
+        state_type& st = state();
+        st.module_count = 0;
+        ::dl_iterate_phdr(&crash_handler::on_module, &st);
+    }
+
+private:
+
+    struct module_type
+    {
+        std::size_t  start;
+        std::size_t  end;
+        std::size_t  bias;   ///< load address; addresses in the file are (addr - bias)
+        char         name[max_module_name];
+    };
+
+    static const std::size_t signal_count = 6;
+
+    enum report_state
+    {
+        idle,
+        writing,
+        written
+    };
+
+    struct state_type
+    {
+        int                     fd;
+        volatile sig_atomic_t   installed;
+        int                     in_handler;   ///< report_state, atomic: threads can crash together
+        int                     writer;       ///< the thread writing the report
+
+        struct sigaction        old_actions[signal_count];
+
+        module_type             modules[max_modules];
+        std::size_t             module_count;
+
+        char                    alt_stack[alt_stack_size];
+    };
+
+    struct signal_type
+    {
+        int          signo;
+        const char*  name;
+    };
+
+    static const signal_type* signals()
+    {
+        static const signal_type sigs[signal_count] = {
+            { SIGSEGV, "SIGSEGV" },
+            { SIGBUS,  "SIGBUS"  },
+            { SIGILL,  "SIGILL"  },
+            { SIGFPE,  "SIGFPE"  },
+            { SIGABRT, "SIGABRT" },
+            { SIGTRAP, "SIGTRAP" },
+        };
+        return sigs;
+    }
+
+    static state_type& state()
+    {
+        static state_type st; // POD: zero-initialized, no guard
+        return st;
+    }
+
+    static int on_module(struct dl_phdr_info* info, size_t /*size*/, void* data)
+    {
+        state_type& st = *static_cast<state_type*>(data);
+        if (st.module_count >= max_modules)
+        {
+            return 1;
+        }
+
+        std::size_t start = ~std::size_t(0);
+        std::size_t end   = 0;
+        for (int i = 0; i < info->dlpi_phnum; ++i)
+        {
+            if (info->dlpi_phdr[i].p_type != PT_LOAD)
+                continue;
+            std::size_t seg = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+            start = std::min(start, seg);
+            end   = std::max(end, static_cast<std::size_t>(seg + info->dlpi_phdr[i].p_memsz));
+        }
+        if (start >= end)
+        {
+            return 0;
+        }
+
+        module_type& mod = st.modules[st.module_count++];
+        mod.start = start;
+        mod.end   = end;
+        mod.bias  = info->dlpi_addr;
+        mod.name[0] = '\0';
+        if (info->dlpi_name && *info->dlpi_name)
+        {
+            std::strncpy(mod.name, info->dlpi_name, max_module_name - 1);
+            mod.name[max_module_name - 1] = '\0';
+        }
+        else if (st.module_count == 1)
+        {
+            // The executable itself
+            ssize_t len = ::readlink("/proc/self/exe", mod.name, max_module_name - 1);
+            mod.name[len > 0 ? len : 0] = '\0';
+        }
+        return 0;
+    }
+
+    static const module_type* find_module(const state_type& st, std::size_t addr)
+    {
+        for (std::size_t i = 0; i < st.module_count; ++i)
+        {
+            if (addr >= st.modules[i].start && addr < st.modules[i].end)
+            {
+                return &st.modules[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static void write_all(int fd, const char* buf, std::size_t len)
+    {
+        while (len)
+        {
+            ssize_t ret = ::write(fd, buf, len);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return;
+            buf += ret;
+            len -= static_cast<std::size_t>(ret);
+        }
+    }
+
+    static void write_frame(const state_type& st, std::size_t idx, address_type addr)
+    {
+        fixed_output_buffer<max_module_name + 64> line;
+        line.append('#').append_dec(idx).append("  ").append_address(addr);
+
+        std::size_t uaddr = reinterpret_cast<std::size_t>(addr);
+        const module_type* mod = find_module(st, uaddr);
+        if (mod)
+        {
+            line.append(" in ").append(*mod->name ? mod->name : "??")
+                .append("+0x").append_hex(uaddr - mod->bias);
+        }
+        line.append('\n');
+        write_all(st.fd, line.c_str(), line.size());
+    }
+
+    static void on_signal(int signo, siginfo_t* info, void* context)
+    {
+        int saved_errno = errno;
+        state_type& st = state();
+
+        std::size_t idx = 0;
+        for ( ; idx < signal_count && signals()[idx].signo != signo; ++idx)
+            ;
+        BOOST_ASSERT(idx < signal_count);
+
+        const int tid = static_cast<int>(::syscall(SYS_gettid));
+        int expected = idle;
+        if (__atomic_compare_exchange_n(&st.in_handler, &expected, int(writing), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&st.writer, tid, __ATOMIC_RELEASE);
+
+            fixed_output_buffer<256> header;
+            header.append("*** Caught signal ").append_dec(signo)
+                  .append(" (").append(signals()[idx].name).append("), address ")
+                  .append_address(info->si_addr)
+                  .append(", pid ").append_dec(::getpid())
+                  .append(", tid ").append_dec(tid)
+                  .append(":\n");
+            write_all(st.fd, header.c_str(), header.size());
+
+            // Skip this handler and the signal trampoline: start at the
+            // interrupted instruction.
+            boost::array<call_frame_impl, max_depth> frames;
+            std::size_t depth = get_stack(frames, *static_cast<const context_type*>(context));
+            for (std::size_t i = 0; i < depth; ++i)
+            {
+                write_frame(st, i, frames[i].addr());
+            }
+
+            static const char footer[] = "*** End of stack\n";
+            write_all(st.fd, footer, sizeof(footer) - 1);
+            __atomic_store_n(&st.in_handler, written, __ATOMIC_RELEASE);
+        }
+        else if (expected == writing && __atomic_load_n(&st.writer, __ATOMIC_ACQUIRE) != tid)
+        {
+            // Another thread is writing its report: let it finish before
+            // the process goes, for a while.  Not if the writer crashed.
+            for (int i = 0; i < 2000 && __atomic_load_n(&st.in_handler, __ATOMIC_ACQUIRE) == writing; ++i)
+            {
+                struct timespec ts = { 0, 1000000 };
+                ::nanosleep(&ts, nullptr);
+            }
+        }
+
+        // Chain: restore the previous disposition and let it run.  Faults
+        // re-trigger when returning to the faulting instruction, sent
+        // signals must be sent again.
+        ::sigaction(signo, &st.old_actions[idx], nullptr);
+        if (info->si_code <= 0 || signo == SIGABRT)
+        {
+            ::raise(signo);
+        }
+        errno = saved_errno;
+    }
+}; //crash_handler
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_CRASH_HANDLER_HPP)
@@ -0,0 +1,322 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_MALLOC_HOOKS_HPP)
+#define BOOST_CALL_STACK_GNU_MALLOC_HOOKS_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/atomic.hpp>
+
+#include <malloc.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+
+
+/*
+ * Interposition of the glibc allocator: malloc() & co. are defined by the
+ * program (in the one translation unit defining
+ * BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS), call the glibc implementation
+ * (__libc_malloc() & co.) then tell the observers registered.  operator
+ * new and delete are replaced to go through them.
+ */
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void  __libc_free(void* ptr);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void* __libc_valloc(size_t size);
+    void* __libc_pvalloc(size_t size);
+
+    /// Defined with the hooks: tells whether they are in the program.
+    extern int boost_call_stack_malloc_hooks __attribute__((weak));
+}
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class malloc_hooks
+{
+public:
+
+    typedef void (*alloc_observer)(void* ptr, std::size_t size);
+    typedef void (*free_observer)(void* ptr);
+
+    static const std::size_t max_observers = 4;
+
+    /**
+     * @return true if the hooks are linked in the program.
+     */
+    static bool defined()
+    {
+        return &boost_call_stack_malloc_hooks != nullptr;
+    }
+
+    /**
+     * Register an observer of allocations and deallocations.  Observers
+     * are called outside of the hooks: their own allocations are not
+     * observed.
+     * @return false if there are too many observers.
+     */
+    static bool add(alloc_observer on_alloc, free_observer on_free)
+    {
+        for (std::size_t i = 0; i < max_observers; ++i)
+        {
+            alloc_observer expected = nullptr;
+            if (allocs()[i].compare_exchange_strong(expected, on_alloc))
+            {
+                frees()[i].store(on_free);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Unregister; the observer might still be running in other threads
+     * for a while.
+     */
+    static void remove(alloc_observer on_alloc)
+    {
+        for (std::size_t i = 0; i < max_observers; ++i)
+        {
+            if (allocs()[i].load() == on_alloc)
+            {
+                frees()[i].store(nullptr);
+                allocs()[i].store(nullptr);
+            }
+        }
+    }
+
+    static void on_alloc(void* ptr, std::size_t size)
+    {
+        if (!ptr || in_hook())
+        {
+            return;
+        }
+        scoped_guard guard;
+        for (std::size_t i = 0; i < max_observers; ++i)
+        {
+            alloc_observer obs = allocs()[i].load(boost::memory_order_acquire);
+            if (obs)
+            {
+                obs(ptr, size);
+            }
+        }
+    }
+
+    static void on_free(void* ptr)
+    {
+        if (!ptr || in_hook())
+        {
+            return;
+        }
+        scoped_guard guard;
+        for (std::size_t i = 0; i < max_observers; ++i)
+        {
+            free_observer obs = frees()[i].load(boost::memory_order_acquire);
+            if (obs)
+            {
+                obs(ptr);
+            }
+        }
+    }
+
+    /**
+     * While in scope, the allocations of the calling thread are not
+     * observed.
+     */
+    struct scoped_guard
+    {
+        bool  was;
+
+        scoped_guard() : was(in_hook()) { in_hook() = true; }
+        ~scoped_guard()                 { in_hook() = was; }
+    };
+
+private:
+
+    static bool& in_hook()
+    {
+        static __thread bool flag = false;
+        return flag;
+    }
+
+    static boost::atomic<alloc_observer>* allocs()
+    {
+        static boost::atomic<alloc_observer> obs[max_observers];
+        return obs;
+    }
+
+    static boost::atomic<free_observer>* frees()
+    {
+        static boost::atomic<free_observer> obs[max_observers];
+        return obs;
+    }
+}; //malloc_hooks
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#if defined(BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS)
+
+extern "C"
+{
+
+int boost_call_stack_malloc_hooks = 1;
+
+void* malloc(size_t size) noexcept
+{
+    void* ptr = __libc_malloc(size);
+    boost::call_stack::detail::malloc_hooks::on_alloc(ptr, size);
+    return ptr;
+}
+
+void free(void* ptr) noexcept
+{
+    boost::call_stack::detail::malloc_hooks::on_free(ptr);
+    __libc_free(ptr);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    void* ptr = __libc_calloc(count, size);
+    boost::call_stack::detail::malloc_hooks::on_alloc(ptr, count * size);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    // Told before the block is released, as by free(): once released, its
+    // address can be reused, and recorded, by another thread
+    boost::call_stack::detail::malloc_hooks::on_free(ptr);
+    void* ret = __libc_realloc(ptr, size);
+    if (ret || !size)
+    {
+        boost::call_stack::detail::malloc_hooks::on_alloc(ret, size);
+    }
+    else if (ptr)
+    {
+        // Failed: the block is still there
+        boost::call_stack::detail::malloc_hooks::on_alloc(ptr, ::malloc_usable_size(ptr));
+    }
+    return ret;
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    void* ptr = __libc_memalign(alignment, size);
+    boost::call_stack::detail::malloc_hooks::on_alloc(ptr, size);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void*) || (alignment & (alignment - 1)))
+    {
+        return EINVAL;
+    }
+    void* ptr = memalign(alignment, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void* valloc(size_t size) noexcept
+{
+    void* ptr = __libc_valloc(size);
+    boost::call_stack::detail::malloc_hooks::on_alloc(ptr, size);
+    return ptr;
+}
+
+void* pvalloc(size_t size) noexcept
+{
+    void* ptr = __libc_pvalloc(size);
+    boost::call_stack::detail::malloc_hooks::on_alloc(ptr, size);
+    return ptr;
+}
+
+} // extern "C"
+
+
+void* operator new(std::size_t size)
+{
+    for (;;)
+    {
+        if (void* ptr = malloc(size ? size : 1))
+        {
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return ::operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept                            { free(ptr); }
+void operator delete[](void* ptr) noexcept                          { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept     { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept   { free(ptr); }
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* ptr, std::size_t) noexcept               { free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept             { free(ptr); }
+#endif
+
+#endif //#if defined(BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS)
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_MALLOC_HOOKS_HPP)
@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_MODULES_HPP)
+#define BOOST_CALL_STACK_GNU_MODULES_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <link.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+/*
+ * The binaries loaded in the process, from the dynamic linker.
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+/**
+ * An executable segment of a loaded binary.
+ */
+struct module_info
+{
+    std::size_t  start;     ///< first address
+    std::size_t  limit;     ///< one past the last address
+    std::size_t  offset;    ///< offset in the file of the first address
+    std::string  name;      ///< path of the binary
+
+    bool operator<(const module_info& other) const { return start < other.start; }
+};
+
+
+inline int on_module_info(struct dl_phdr_info* info, size_t /*size*/, void* data)
+{
+    std::vector<module_info>& modules = *static_cast<std::vector<module_info>*>(data);
+
+    std::string name(info->dlpi_name ? info->dlpi_name : "");
+    if (name.empty() && modules.empty())
+    {
+        // The executable comes first, unnamed
+        char exe[4096];
+        ssize_t len = ::readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        name.assign(exe, len > 0 ? static_cast<std::size_t>(len) : 0);
+    }
+
+    for (int i = 0; i < info->dlpi_phnum; ++i)
+    {
+        const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+        if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X))
+            continue;
+        module_info mod;
+        mod.start  = info->dlpi_addr + phdr.p_vaddr;
+        mod.limit  = mod.start + phdr.p_memsz;
+        mod.offset = phdr.p_offset;
+        mod.name   = name;
+        modules.push_back(mod);
+    }
+    return 0;
+}
+
+/**
+ * @return the executable segments of the binaries loaded, by address.
+ */
+inline std::vector<module_info> list_modules()
+{
+    std::vector<module_info> modules;
+    ::dl_iterate_phdr(&on_module_info, &modules);
+    std::sort(modules.begin(), modules.end());
+    return modules;
+}
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_MODULES_HPP)
@@ -0,0 +1,278 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_PERF_HPP)
+#define BOOST_CALL_STACK_GNU_PERF_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/sampler.hpp>
+#include <boost/call_stack/detail/gnu/threads.hpp>
+
+#include <boost/static_assert.hpp>
+#include <boost/assert.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+
+/*
+ * Per-thread perf events (perf_event_open(2)) sampling user call chains: the
+ * kernel walks the stack of the thread (frame pointers) and writes the
+ * chain into a ring buffer shared with the process; the sampled thread
+ * runs no code of ours.
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+template < typename CallStack >
+class perf_sampler
+{
+public:
+
+    typedef CallStack                 stack_type;
+    typedef sample_type<stack_type>   sample_entry_type;
+
+    static const std::size_t data_pages = 16;
+    BOOST_STATIC_ASSERT_MSG((data_pages & (data_pages - 1)) == 0, "data_pages must be a power of 2");
+
+    /// Longest call chain read from the ring; the kernel default is 127.
+    static const std::size_t max_chain = 512;
+
+    struct ring_type
+    {
+        int                              fd;
+        void*                            base;       ///< metadata page, then data pages
+        std::size_t                      mmap_size;
+        thread_id_type                   tid;
+        bool                             hardware;   ///< counts cycles, else CPU time
+        boost::uint64_t                  period_ns;
+        boost::atomic<boost::uint64_t>   dropped;
+
+        ring_type()
+            : fd(-1), base(MAP_FAILED), mmap_size(0), tid(0)
+            , hardware(false), period_ns(0), dropped(0)
+        {}
+    };
+
+    /*
+     * No signals involved.
+     */
+    static bool install(int /*signo*/) { return true; }
+    static void uninstall(int /*signo*/) {}
+
+    static ring_type* acquire()
+    {
+        return new ring_type();
+    }
+
+    /**
+     * The kernel writes nothing to the ring once it is unmapped: freed.
+     */
+    static void release(ring_type* ring)
+    {
+        disarm(*ring);
+        if (ring->base != MAP_FAILED)
+        {
+            ::munmap(ring->base, ring->mmap_size);
+        }
+        if (ring->fd >= 0)
+        {
+            ::close(ring->fd);
+        }
+        delete ring;
+    }
+
+    /**
+     * Start sampling thread tid: every period_ns of its CPU time (task
+     * clock), or as often on average in cycles if clk is cpu_cycles and the
+     * hardware can count them.  The kernel cannot sample blocked threads:
+     * wall_time is not supported.
+     * @return true if successful.
+     */
+    static bool arm(ring_type& ring, thread_id_type tid, sampling_clock clk, int /*signo*/,
+                    boost::uint64_t period_ns)
+    {
+        if (clk == wall_time || period_ns == 0)
+        {
+            return false;
+        }
+        ring.tid       = tid;
+        ring.period_ns = period_ns;
+
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size                     = sizeof(attr);
+        attr.sample_type              = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+        attr.disabled                 = 1;
+        attr.exclude_kernel           = 1;
+        attr.exclude_hv               = 1;
+        attr.exclude_callchain_kernel = 1;
+
+        ring.fd = -1;
+        if (clk == cpu_cycles)
+        {
+            attr.type        = PERF_TYPE_HARDWARE;
+            attr.config      = PERF_COUNT_HW_CPU_CYCLES;
+            attr.freq        = 1;
+            attr.sample_freq = (period_ns < 1000000000ull) ? 1000000000ull / period_ns : 1;
+            ring.fd = open_event(attr, tid);
+            ring.hardware = (ring.fd >= 0);
+        }
+        if (ring.fd < 0)
+        {
+            // No PMU (e.g. virtual machines): fall back to the software clock
+            attr.type          = PERF_TYPE_SOFTWARE;
+            attr.config        = PERF_COUNT_SW_TASK_CLOCK;
+            attr.freq          = 0;
+            attr.sample_period = period_ns;
+            ring.fd = open_event(attr, tid);
+        }
+        if (ring.fd < 0)
+        {
+            return false;
+        }
+
+        const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        ring.mmap_size = (1 + data_pages) * page_size;
+        ring.base = ::mmap(nullptr, ring.mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd, 0);
+        if (ring.base == MAP_FAILED)
+        {
+            return false;
+        }
+
+        return ::ioctl(ring.fd, PERF_EVENT_IOC_ENABLE, 0) == 0;
+    }
+
+    static void disarm(ring_type& ring)
+    {
+        if (ring.fd >= 0)
+        {
+            ::ioctl(ring.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    /**
+     * Hand the samples in the ring to f (a callable taking a
+     * const sample_entry_type&).  One consumer at a time.
+     * @return the number of samples.
+     */
+    template < typename Consumer >
+    static std::size_t drain(ring_type& ring, Consumer& f)
+    {
+        if (ring.base == MAP_FAILED)
+        {
+            return 0;
+        }
+
+        struct perf_event_mmap_page* meta = static_cast<struct perf_event_mmap_page*>(ring.base);
+        const char*           data = static_cast<const char*>(ring.base) + (ring.mmap_size / (1 + data_pages));
+        const boost::uint64_t size = ring.mmap_size - (ring.mmap_size / (1 + data_pages));
+
+        const boost::uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+        boost::uint64_t       tail = meta->data_tail;
+
+        // Records: header, then for samples u32 pid, u32 tid, u64 nr, u64 ips[nr]
+        boost::uint64_t   record[3 + max_chain];
+        address_type      addrs[max_chain];
+        sample_entry_type entry;
+        entry.weight     = ring.period_ns;
+        entry.off_cpu_ns = 0;
+
+        std::size_t count = 0;
+        while (tail < head)
+        {
+            struct perf_event_header header;
+            copy_out(data, size, tail, &header, sizeof(header));
+            if (header.size < sizeof(header))
+            {
+                break;  // Corrupt
+            }
+
+            if (header.type == PERF_RECORD_SAMPLE && header.size <= sizeof(record))
+            {
+                copy_out(data, size, tail, record, header.size);
+                boost::uint32_t pid_tid[2];
+                std::memcpy(pid_tid, &record[1], sizeof(pid_tid));
+                const boost::uint32_t tid = pid_tid[1];
+                const boost::uint64_t nr  = (std::min)(record[2], static_cast<boost::uint64_t>((header.size - 3 * sizeof(boost::uint64_t)) / sizeof(boost::uint64_t)));
+                std::size_t depth = 0;
+                for (boost::uint64_t i = 0; i < nr; ++i)
+                {
+                    if (record[3 + i] >= static_cast<boost::uint64_t>(PERF_CONTEXT_MAX))
+                        continue; // PERF_CONTEXT_USER & co.
+                    addrs[depth++] = reinterpret_cast<address_type>(static_cast<std::uintptr_t>(record[3 + i]));
+                }
+                if (static_cast<thread_id_type>(tid) == ring.tid && depth > 0)
+                {
+                    entry.stack.assign(addrs, depth);
+                    f(entry);
+                    ++count;
+                }
+            }
+            else if (header.type == PERF_RECORD_SAMPLE)
+            {
+                ++ring.dropped;  // Longer than max_chain
+            }
+            else if (header.type == PERF_RECORD_LOST)
+            {
+                boost::uint64_t lost[3]; // header, id, lost
+                copy_out(data, size, tail, lost, sizeof(lost));
+                ring.dropped += lost[2];
+            }
+            tail += header.size;
+        }
+
+        __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+
+    static int open_event(struct perf_event_attr& attr, thread_id_type tid)
+    {
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    /*
+     * Copy len bytes at offset pos of the data pages, which wrap around.
+     */
+    static void copy_out(const char* data, boost::uint64_t size, boost::uint64_t pos,
+                         void* to, std::size_t len)
+    {
+        const std::size_t offset = static_cast<std::size_t>(pos & (size - 1));
+        const std::size_t first  = (std::min)(len, static_cast<std::size_t>(size - offset));
+        std::memcpy(to, data + offset, first);
+        std::memcpy(static_cast<char*>(to) + first, data, len - first);
+    }
+}; //perf_sampler
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_PERF_HPP)
@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_RATE_LIMITER_HPP)
+#define BOOST_CALL_STACK_GNU_RATE_LIMITER_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/threads.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/**
+ * Rate limit, by one-second windows: admits at most max events in each
+ * second of the monotonic clock.  Lock-free; events racing the start of a
+ * window can be counted in the previous one.
+ */
+class rate_limiter : private boost::noncopyable
+{
+public:
+
+    rate_limiter()
+        : _window(0)
+        , _count(0)
+    {}
+
+    /**
+     * @param max Events admitted per second; 0: no limit.
+     * @return true if the event is admitted.
+     */
+    bool admit(boost::uint32_t max)
+    {
+        if (!max)
+        {
+            return true;
+        }
+        const boost::uint64_t now = monotonic_ns() / 1000000000ull;
+        boost::uint64_t current = _window.load(boost::memory_order_relaxed);
+        if (now != current && _window.compare_exchange_strong(current, now))
+        {
+            _count = 0;
+        }
+        return ++_count <= max;
+    }
+
+private:
+
+    boost::atomic<boost::uint64_t>  _window;   ///< second of the current window
+    boost::atomic<boost::uint32_t>  _count;    ///< events in it
+}; //rate_limiter
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_RATE_LIMITER_HPP)
@@ -0,0 +1,315 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_RESOURCE_HOOKS_HPP)
+#define BOOST_CALL_STACK_GNU_RESOURCE_HOOKS_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/atomic.hpp>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/*
+ * Interposition of the calls creating and releasing file descriptors and
+ * threads: open(), openat(), socket(), accept(), accept4(), dup(), close(),
+ * pthread_create(), pthread_join() and pthread_detach() are defined by the
+ * program (in the one translation unit defining
+ * BOOST_CALL_STACK_DEFINE_RESOURCE_HOOKS), call the next definition (the C
+ * library's) then tell the observers.  Descriptors created otherwise
+ * (fopen(), pipe()...) are not seen.
+ */
+
+extern "C"
+{
+    /// Defined with the hooks: tells whether they are in the program.
+    extern int boost_call_stack_resource_hooks __attribute__((weak));
+}
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class resource_hooks
+{
+public:
+
+    enum thread_event
+    {
+        thread_started,
+        thread_released,   ///< about to be joined or detached
+        thread_kept        ///< the join or detach just released failed
+    };
+
+    typedef void (*fd_observer)(int fd, bool opened);
+    typedef void (*thread_observer)(pthread_t thread, thread_event event);
+
+    /**
+     * @return true if the hooks are linked in the program.
+     */
+    static bool defined()
+    {
+        return &boost_call_stack_resource_hooks != nullptr;
+    }
+
+    /**
+     * Set the observers, nullptr for none.  They are called on the thread
+     * creating or releasing the resource: before a descriptor is closed or
+     * a thread joined or detached (either can be reused as soon as it is),
+     * after it is created.  Resources created and released by the
+     * observers are not observed.
+     */
+    static void observe(fd_observer on_fd, thread_observer on_thread)
+    {
+        fds().store(on_fd, boost::memory_order_release);
+        threads().store(on_thread, boost::memory_order_release);
+    }
+
+    static void on_fd(int fd, bool opened)
+    {
+        fd_observer obs = fds().load(boost::memory_order_acquire);
+        if (obs && fd >= 0 && !in_hook())
+        {
+            scoped_guard guard;
+            obs(fd, opened);
+        }
+    }
+
+    static void on_thread(pthread_t thread, thread_event event)
+    {
+        thread_observer obs = threads().load(boost::memory_order_acquire);
+        if (obs && !in_hook())
+        {
+            scoped_guard guard;
+            obs(thread, event);
+        }
+    }
+
+    /**
+     * @return the definition of name after the program's.
+     */
+    template < typename Function >
+    static Function next(const char* name)
+    {
+        return reinterpret_cast<Function>(::dlsym(RTLD_NEXT, name));
+    }
+
+    /**
+     * While in scope, the resources of the calling thread are not observed.
+     */
+    struct scoped_guard
+    {
+        bool  was;
+
+        scoped_guard() : was(in_hook()) { in_hook() = true; }
+        ~scoped_guard()                 { in_hook() = was; }
+    };
+
+private:
+
+    static bool& in_hook()
+    {
+        static __thread bool flag = false;
+        return flag;
+    }
+
+    static boost::atomic<fd_observer>& fds()
+    {
+        static boost::atomic<fd_observer> obs(nullptr);
+        return obs;
+    }
+
+    static boost::atomic<thread_observer>& threads()
+    {
+        static boost::atomic<thread_observer> obs(nullptr);
+        return obs;
+    }
+}; //resource_hooks
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#if defined(BOOST_CALL_STACK_DEFINE_RESOURCE_HOOKS)
+
+#define BOOST_CALL_STACK_RESOURCE_NEXT(name, type)                                          \
+    static type next = boost::call_stack::detail::resource_hooks::next<type>(#name);        \
+    if (!next)                                                                              \
+    {                                                                                       \
+        errno = ENOSYS;                                                                     \
+        return -1;                                                                          \
+    }
+
+extern "C"
+{
+
+int boost_call_stack_resource_hooks = 1;
+
+int open(const char* path, int flags, ...)
+{
+    typedef int (*open_type)(const char*, int, ...);
+    BOOST_CALL_STACK_RESOURCE_NEXT(open, open_type)
+
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    const int fd = next(path, flags, mode);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int openat(int dir, const char* path, int flags, ...)
+{
+    typedef int (*openat_type)(int, const char*, int, ...);
+    BOOST_CALL_STACK_RESOURCE_NEXT(openat, openat_type)
+
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    const int fd = next(dir, path, flags, mode);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int socket(int domain, int type, int protocol) noexcept
+{
+    typedef int (*socket_type)(int, int, int);
+    BOOST_CALL_STACK_RESOURCE_NEXT(socket, socket_type)
+
+    const int fd = next(domain, type, protocol);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int accept(int sock, struct sockaddr* addr, socklen_t* len)
+{
+    typedef int (*accept_type)(int, struct sockaddr*, socklen_t*);
+    BOOST_CALL_STACK_RESOURCE_NEXT(accept, accept_type)
+
+    const int fd = next(sock, addr, len);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int accept4(int sock, struct sockaddr* addr, socklen_t* len, int flags)
+{
+    typedef int (*accept4_type)(int, struct sockaddr*, socklen_t*, int);
+    BOOST_CALL_STACK_RESOURCE_NEXT(accept4, accept4_type)
+
+    const int fd = next(sock, addr, len, flags);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int dup(int old) noexcept
+{
+    typedef int (*dup_type)(int);
+    BOOST_CALL_STACK_RESOURCE_NEXT(dup, dup_type)
+
+    const int fd = next(old);
+    boost::call_stack::detail::resource_hooks::on_fd(fd, true);
+    return fd;
+}
+
+int close(int fd)
+{
+    typedef int (*close_type)(int);
+    BOOST_CALL_STACK_RESOURCE_NEXT(close, close_type)
+
+    boost::call_stack::detail::resource_hooks::on_fd(fd, false);
+    return next(fd);
+}
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg) noexcept
+{
+    typedef int (*pthread_create_type)(pthread_t*, const pthread_attr_t*, void* (*)(void*), void*);
+    static pthread_create_type next = boost::call_stack::detail::resource_hooks::next<pthread_create_type>("pthread_create");
+    if (!next)
+    {
+        return ENOSYS;
+    }
+
+    const int ret = next(thread, attr, start, arg);
+    int state = PTHREAD_CREATE_JOINABLE;
+    if (!ret && (!attr || (::pthread_attr_getdetachstate(attr, &state) == 0 && state == PTHREAD_CREATE_JOINABLE)))
+    {
+        boost::call_stack::detail::resource_hooks::on_thread(*thread, boost::call_stack::detail::resource_hooks::thread_started);
+    }
+    return ret;
+}
+
+int pthread_join(pthread_t thread, void** result)
+{
+    typedef int (*pthread_join_type)(pthread_t, void**);
+    static pthread_join_type next = boost::call_stack::detail::resource_hooks::next<pthread_join_type>("pthread_join");
+    if (!next)
+    {
+        return ENOSYS;
+    }
+
+    boost::call_stack::detail::resource_hooks::on_thread(thread, boost::call_stack::detail::resource_hooks::thread_released);
+    const int ret = next(thread, result);
+    if (ret && ret != ESRCH)
+    {
+        boost::call_stack::detail::resource_hooks::on_thread(thread, boost::call_stack::detail::resource_hooks::thread_kept);
+    }
+    return ret;
+}
+
+int pthread_detach(pthread_t thread) noexcept
+{
+    typedef int (*pthread_detach_type)(pthread_t);
+    static pthread_detach_type next = boost::call_stack::detail::resource_hooks::next<pthread_detach_type>("pthread_detach");
+    if (!next)
+    {
+        return ENOSYS;
+    }
+
+    boost::call_stack::detail::resource_hooks::on_thread(thread, boost::call_stack::detail::resource_hooks::thread_released);
+    const int ret = next(thread);
+    if (ret && ret != ESRCH)
+    {
+        boost::call_stack::detail::resource_hooks::on_thread(thread, boost::call_stack::detail::resource_hooks::thread_kept);
+    }
+    return ret;
+}
+
+} // extern "C"
+
+#undef BOOST_CALL_STACK_RESOURCE_NEXT
+
+#endif //#if defined(BOOST_CALL_STACK_DEFINE_RESOURCE_HOOKS)
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_RESOURCE_HOOKS_HPP)
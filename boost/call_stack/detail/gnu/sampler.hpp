@@ -0,0 +1,361 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_SAMPLER_HPP)
+#define BOOST_CALL_STACK_GNU_SAMPLER_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/stack.hpp>
+#include <boost/call_stack/detail/gnu/threads.hpp>
+
+#include <boost/static_assert.hpp>
+#include <boost/assert.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/cstdint.hpp>
+
+#include <signal.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+
+/*
+ * Per-thread timers delivering a signal to the thread they measure; the
+ * signal handler captures the interrupted stack into a lock-free ring
+ * owned by the thread (single producer: the handler; single consumer:
+ * whoever drains the ring).  Timers run on the CPU-time clock of the
+ * thread (on-CPU samples) or on the monotonic clock (all threads, running
+ * or not: the handler tells the time spent off CPU since the last sample).
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+/**
+ * @return the CPU-time clock of a thread of this process (the Linux ABI
+ * behind pthread_getcpuclockid(3), for a kernel thread id).
+ */
+inline clockid_t thread_cpu_clock(thread_id_type tid)
+{
+    static const clockid_t cpuclock_sched          = 2;
+    static const clockid_t cpuclock_perthread_mask = 4;
+    return (~static_cast<clockid_t>(tid) << 3) | cpuclock_sched | cpuclock_perthread_mask;
+}
+
+
+/**
+ * @return the CPU time consumed by the calling thread, in nanoseconds.
+ * Async-signal-safe.
+ */
+inline boost::uint64_t thread_cpu_ns()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<boost::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<boost::uint64_t>(ts.tv_nsec);
+}
+
+
+/**
+ * What drives the sampling timers.
+ */
+enum sampling_clock
+{
+    cpu_time,   ///< CPU time of the sampled thread: on-CPU samples only
+    wall_time,  ///< Elapsed time: threads are sampled whether running or blocked
+    cpu_cycles  ///< CPU cycles if the hardware can count them, else cpu_time
+};
+
+
+template < typename CallStack >
+struct sample_type
+{
+    CallStack        stack;
+    boost::uint64_t  weight;       ///< on-CPU nanoseconds
+    boost::uint64_t  off_cpu_ns;   ///< off-CPU nanoseconds; wall_time only
+};
+
+
+template < typename CallStack >
+class thread_sampler
+{
+public:
+
+    typedef CallStack                 stack_type;
+    typedef sample_type<stack_type>   sample_entry_type;
+
+    static const std::size_t ring_size = 64;
+    BOOST_STATIC_ASSERT_MSG((ring_size & (ring_size - 1)) == 0, "ring_size must be a power of 2");
+
+    struct ring_type
+    {
+        sample_entry_type            entries[ring_size];
+        boost::atomic<std::size_t>   head;      ///< next to read; consumer
+        boost::atomic<std::size_t>   tail;      ///< next to write; producer
+        boost::atomic<boost::uint64_t> dropped;
+        boost::atomic<bool>          active;
+
+        thread_id_type               tid;
+        timer_t                      timer;
+        bool                         has_timer;
+        sampling_clock               clock;
+        boost::uint64_t              period_ns;
+        boost::uint64_t              last_wall_ns;   ///< wall_time: at the previous sample
+        boost::uint64_t              last_cpu_ns;    ///< wall_time: at the previous sample
+        ring_type*                   next;
+
+        ring_type()
+            : head(0), tail(0), dropped(0), active(false)
+            , tid(0), has_timer(false), clock(cpu_time), period_ns(0)
+            , last_wall_ns(0), last_cpu_ns(0), next(nullptr)
+        {}
+    };
+
+    /**
+     * Install the signal handler for signo.
+     * @return true if successful, false if signo has a handler already.
+     */
+    static bool install(int signo)
+    {
+        BOOST_ASSERT(signo > 0 && signo < NSIG);
+        boost::mutex::scoped_lock lock(pool().mutex);
+        if (pool().users[signo]++ > 0)
+        {
+            return true;
+        }
+
+        struct sigaction old;
+        if (::sigaction(signo, nullptr, &old) != 0
+         || (old.sa_flags & SA_SIGINFO)
+         || (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN))
+        {
+            --pool().users[signo];
+            return false;
+        }
+
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &thread_sampler::on_signal;
+        sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+        ::sigemptyset(&sa.sa_mask);
+        if (::sigaction(signo, &sa, &pool().old_actions[signo]) != 0)
+        {
+            --pool().users[signo];
+            return false;
+        }
+        return true;
+    }
+
+    static void uninstall(int signo)
+    {
+        BOOST_ASSERT(signo > 0 && signo < NSIG);
+        boost::mutex::scoped_lock lock(pool().mutex);
+        if (--pool().users[signo] == 0)
+        {
+            ::sigaction(signo, &pool().old_actions[signo], nullptr);
+        }
+    }
+
+    static ring_type* acquire()
+    {
+        boost::mutex::scoped_lock lock(pool().mutex);
+        ring_type* ring = pool().free;
+        if (ring)
+        {
+            pool().free = ring->next;
+        }
+        else
+        {
+            ring = new ring_type();
+        }
+        ring->next = nullptr;
+        ring->head.store(0);
+        ring->tail.store(0);
+        ring->dropped.store(0);
+        ring->has_timer = false;
+        return ring;
+    }
+
+    /**
+     * The ring goes back to the pool; never freed since a late signal
+     * might still refer to it.
+     */
+    static void release(ring_type* ring)
+    {
+        disarm(*ring);
+        boost::mutex::scoped_lock lock(pool().mutex);
+        ring->next = pool().free;
+        pool().free = ring;
+    }
+
+    /**
+     * Start sampling thread tid every period_ns of clock clk; timers cannot
+     * count cycles, cpu_cycles means cpu_time.
+     * @return true if successful.
+     */
+    static bool arm(ring_type& ring, thread_id_type tid, sampling_clock clk, int signo,
+                    boost::uint64_t period_ns)
+    {
+        ring.tid         = tid;
+        ring.clock       = clk;
+        ring.period_ns   = period_ns;
+
+        const clockid_t timer_clock = (clk == wall_time) ? CLOCK_MONOTONIC : thread_cpu_clock(tid);
+        if (clk == wall_time)
+        {
+            struct timespec ts;
+            if (::clock_gettime(thread_cpu_clock(tid), &ts) != 0)
+            {
+                return false; // Thread is gone
+            }
+            ring.last_cpu_ns  = static_cast<boost::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<boost::uint64_t>(ts.tv_nsec);
+            ring.last_wall_ns = monotonic_ns();
+        }
+
+        struct sigevent sev;
+        std::memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify          = SIGEV_THREAD_ID;
+        sev.sigev_signo           = signo;
+        sev.sigev_value.sival_ptr = &ring;
+        sev._sigev_un._tid        = tid;
+        if (::timer_create(timer_clock, &sev, &ring.timer) != 0)
+        {
+            return false;
+        }
+        ring.has_timer = true;
+        ring.active.store(true, boost::memory_order_release);
+
+        struct itimerspec its;
+        its.it_interval.tv_sec  = static_cast<time_t>(period_ns / 1000000000ull);
+        its.it_interval.tv_nsec = static_cast<long>(period_ns % 1000000000ull);
+        its.it_value = its.it_interval;
+        if (::timer_settime(ring.timer, 0, &its, nullptr) != 0)
+        {
+            disarm(ring);
+            return false;
+        }
+        return true;
+    }
+
+    static void disarm(ring_type& ring)
+    {
+        ring.active.store(false, boost::memory_order_release);
+        if (ring.has_timer)
+        {
+            ::timer_delete(ring.timer);
+            ring.has_timer = false;
+        }
+    }
+
+    /**
+     * Hand the samples in the ring to f (a callable taking a
+     * const sample_entry_type&).  Consumer side; one consumer at a time.
+     * @return the number of samples.
+     */
+    template < typename Consumer >
+    static std::size_t drain(ring_type& ring, Consumer& f)
+    {
+        std::size_t head = ring.head.load(boost::memory_order_relaxed);
+        std::size_t tail = ring.tail.load(boost::memory_order_acquire);
+        for (std::size_t i = head; i != tail; ++i)
+        {
+            f(ring.entries[i & (ring_size - 1)]);
+        }
+        ring.head.store(tail, boost::memory_order_release);
+        return tail - head;
+    }
+
+private:
+
+    struct pool_type
+    {
+        boost::mutex      mutex;
+        ring_type*        free;
+        int               users[NSIG];
+        struct sigaction  old_actions[NSIG];
+
+        pool_type() : free(nullptr)
+        {
+            std::memset(users, 0, sizeof(users));
+            std::memset(old_actions, 0, sizeof(old_actions));
+        }
+    };
+
+    static pool_type& pool()
+    {
+        static pool_type p;
+        return p;
+    }
+
+    static void on_signal(int /*signo*/, siginfo_t* info, void* context)
+    {
+        if (info->si_code != SI_TIMER)
+        {
+            return;
+        }
+        ring_type* ring = static_cast<ring_type*>(info->si_value.sival_ptr);
+        if (!ring || !ring->active.load(boost::memory_order_acquire))
+        {
+            return;
+        }
+
+        int saved_errno = errno;
+        if (ring->tid == current_thread_id())  // Not a stale signal for a recycled ring
+        {
+            std::size_t tail = ring->tail.load(boost::memory_order_relaxed);
+            std::size_t head = ring->head.load(boost::memory_order_acquire);
+            if (tail - head >= ring_size)
+            {
+                ++ring->dropped;
+            }
+            else
+            {
+                sample_entry_type& entry = ring->entries[tail & (ring_size - 1)];
+                entry.stack.get_stack(*static_cast<const context_type*>(context));
+                if (ring->clock == wall_time)
+                {
+                    // Split the time since the previous sample in on and off CPU
+                    const boost::uint64_t wall_ns = monotonic_ns();
+                    const boost::uint64_t cpu_ns  = thread_cpu_ns();
+                    const boost::uint64_t elapsed = wall_ns - ring->last_wall_ns;
+                    const boost::uint64_t on_cpu  = (std::min)(cpu_ns - ring->last_cpu_ns, elapsed);
+                    ring->last_wall_ns = wall_ns;
+                    ring->last_cpu_ns  = cpu_ns;
+                    entry.weight     = on_cpu;
+                    entry.off_cpu_ns = elapsed - on_cpu;
+                }
+                else
+                {
+                    entry.weight     = ring->period_ns;
+                    entry.off_cpu_ns = 0;
+                }
+                ring->tail.store(tail + 1, boost::memory_order_release);
+            }
+        }
+        errno = saved_errno;
+    }
+}; //thread_sampler
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_SAMPLER_HPP)
@@ -0,0 +1,220 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_SHADOW_STACK_HPP)
+#define BOOST_CALL_STACK_GNU_SHADOW_STACK_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/frame.hpp>
+
+#include <boost/array.hpp>
+
+#include <cstddef>
+
+
+/*
+ * Shadow call stack: with code built with -finstrument-functions, GCC calls
+ * __cyg_profile_func_enter() and __cyg_profile_func_exit() around every
+ * function; they are defined by the program (in the one translation unit
+ * defining BOOST_CALL_STACK_DEFINE_SHADOW_STACK_HOOKS) and keep, by thread,
+ * the addresses of the functions entered and not yet exited.
+ */
+
+#if !defined(BOOST_CALL_STACK_SHADOW_STACK_DEPTH)
+#  define BOOST_CALL_STACK_SHADOW_STACK_DEPTH 256
+#endif
+
+extern "C"
+{
+    /// Defined with the hooks: tells whether they are in the program.
+    extern int boost_call_stack_shadow_stack_hooks __attribute__((weak));
+}
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class shadow_stack_hooks
+{
+public:
+
+    static const std::size_t capacity = BOOST_CALL_STACK_SHADOW_STACK_DEPTH;
+
+    /**
+     * @return true if the hooks are linked in the program.
+     */
+    __attribute__((no_instrument_function))
+    static bool defined()
+    {
+        return &boost_call_stack_shadow_stack_hooks != nullptr;
+    }
+
+    /**
+     * The frames are a ring: deeper than the capacity, a function overwrites
+     * the outermost frame kept.
+     */
+    __attribute__((no_instrument_function, always_inline))
+    static void on_enter(address_type fn)
+    {
+        thread_type& th = _thread();
+        const std::size_t depth = th.depth;
+        if (depth < th.low)
+        {
+            th.low = depth;                   // Frames below were overwritten
+        }
+        else if (depth - th.low >= capacity)
+        {
+            th.low = depth + 1 - capacity;    // The outermost is about to be
+        }
+        // A signal handler sees the frame stored, or not counted yet
+        __asm__ __volatile__("" ::: "memory");
+        th.frames[depth % capacity] = fn;
+        __asm__ __volatile__("" ::: "memory");
+        th.depth = depth + 1;
+    }
+
+    __attribute__((no_instrument_function, always_inline))
+    static void on_exit(address_type fn)
+    {
+        thread_type& th = _thread();
+        if (!th.depth)
+        {
+            return;
+        }
+        if (th.depth > th.low && th.frames[(th.depth - 1) % capacity] != fn)
+        {
+            // Frames skipped by longjmp() & co.: unwind to fn if kept
+            for (std::size_t i = th.depth - 1; i-- > th.low; )
+            {
+                if (th.frames[i % capacity] == fn)
+                {
+                    th.depth = i;
+                    return;
+                }
+            }
+        }
+        --th.depth;
+    }
+
+    /**
+     * @return the number of functions entered by the calling thread.
+     */
+    __attribute__((no_instrument_function))
+    static std::size_t depth()
+    {
+        return _thread().depth;
+    }
+
+    /**
+     * Copy the frames kept of the calling thread, innermost function first.
+     * Async-signal-safe.
+     * @return the depth copied, 0 if the shadow stack is empty.  Less than
+     * depth() and than size if outer frames were overwritten.
+     */
+    __attribute__((no_instrument_function))
+    static std::size_t get_frames(address_type* buffer, std::size_t size)
+    {
+        const thread_type& th = _thread();
+        const std::size_t depth = th.depth;
+        const std::size_t kept  = depth > th.low ? depth - th.low : 0;
+        const std::size_t count = kept < size ? kept : size;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            buffer[i] = th.frames[(depth - 1 - i) % capacity];
+        }
+        return count;
+    }
+
+    /**
+     * @return the depth of stack; 0 if the shadow stack is empty, or if
+     * outer frames that would fit in stack were overwritten: the caller
+     * has to unwind.
+     */
+    template < class CallFrame,
+               std::size_t MaxDepth >
+    __attribute__((no_instrument_function))
+    static std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack)
+    {
+        address_type buffer[MaxDepth];
+        const std::size_t count = get_frames(buffer, MaxDepth);
+        if (count < MaxDepth && count < depth())
+        {
+            return 0;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            stack[i] = call_frame_impl(buffer[i]);
+        }
+        return count;
+    }
+
+private:
+
+    /*
+     * Plain data: thread-local.
+     */
+    struct thread_type
+    {
+        address_type  frames[capacity];   ///< by depth % capacity
+        std::size_t   depth;
+        std::size_t   low;                ///< the outermost frame kept
+    };
+
+    __attribute__((no_instrument_function, always_inline))
+    static thread_type& _thread()
+    {
+        static __thread thread_type th;
+        return th;
+    }
+}; //shadow_stack_hooks
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_SHADOW_STACK_HPP)
+
+
+/*
+ * Outside of the include guard: this header is included by all the others,
+ * possibly before the translation unit defining the hooks asks for them.
+ */
+#if defined(BOOST_CALL_STACK_DEFINE_SHADOW_STACK_HOOKS) && !defined(BOOST_CALL_STACK_GNU_SHADOW_STACK_HOOKS_DEFINED)
+#define BOOST_CALL_STACK_GNU_SHADOW_STACK_HOOKS_DEFINED
+
+extern "C"
+{
+
+int boost_call_stack_shadow_stack_hooks = 1;
+
+void __cyg_profile_func_enter(void* fn, void* call_site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void* fn, void* call_site) __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void* fn, void*)
+{
+    boost::call_stack::detail::shadow_stack_hooks::on_enter(static_cast<boost::call_stack::detail::address_type>(fn));
+}
+
+void __cyg_profile_func_exit(void* fn, void*)
+{
+    boost::call_stack::detail::shadow_stack_hooks::on_exit(static_cast<boost::call_stack::detail::address_type>(fn));
+}
+
+} // extern "C"
+
+#endif //#if defined(BOOST_CALL_STACK_DEFINE_SHADOW_STACK_HOOKS) && ...
@@ -19,11 +19,14 @@
 
 #include <boost/call_stack/detail/gnu/symbol.hpp>
 #include <boost/call_stack/detail/gnu/frame.hpp>
+#include <boost/call_stack/detail/gnu/shadow_stack.hpp>
 
 #include <boost/static_assert.hpp>
 #include <boost/assert.hpp>
 #include <boost/array.hpp>
 
+#include <ucontext.h>
+
 
 /*
  *
@@ -40,6 +43,15 @@ template < class CallFrame,
 std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack)
 {
     BOOST_STATIC_ASSERT_MSG((boost::is_base_of<call_frame_impl, CallFrame>::value), "CallFrame must inherit call_frame_impl");
+
+#if defined(BOOST_CALL_STACK_USE_SHADOW_STACK)
+    // Code built with -finstrument-functions: copy rather than unwind
+    if (std::size_t depth = shadow_stack_hooks::get_stack(stack))
+    {
+        return depth;
+    }
+#endif
+
     address_type buffer[MaxDepth] = {0};
 
     int numFrames = ::backtrace(buffer, MaxDepth);
@@ -54,6 +66,147 @@ std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack)
 }
 
 
+/*
+ * Register state of an interrupted thread, as passed to a SA_SIGINFO signal 
+ * handler.
+ */
+
+typedef ucontext_t  context_type;
+
+/**
+ * @return the address of the instruction interrupted by a signal.
+ */
+inline address_type get_context_pc(const context_type& ctx)
+{
+#if defined(__x86_64__)
+    return reinterpret_cast<address_type>(ctx.uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+    return reinterpret_cast<address_type>(ctx.uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+    return reinterpret_cast<address_type>(ctx.uc_mcontext.pc);
+#elif defined(__arm__)
+    return reinterpret_cast<address_type>(ctx.uc_mcontext.arm_pc);
+#else
+#  pragma message("Note: unknown ucontext_t layout. The interrupted instruction is not available.")
+    return null_address;
+#endif
+}
+
+/**
+ * @return the frame pointer of the interrupted frame.
+ */
+inline std::size_t get_context_fp(const context_type& ctx)
+{
+#if defined(__x86_64__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.gregs[REG_RBP]);
+#elif defined(__i386__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.gregs[REG_EBP]);
+#elif defined(__aarch64__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.regs[29]);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @return the stack pointer of the interrupted frame.
+ */
+inline std::size_t get_context_sp(const context_type& ctx)
+{
+#if defined(__x86_64__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__i386__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.gregs[REG_ESP]);
+#elif defined(__aarch64__)
+    return static_cast<std::size_t>(ctx.uc_mcontext.sp);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Walk the frame pointer chain starting at the given register state. Only
+ * reliable for code built with -fno-omit-frame-pointer.  Every link is 
+ * sanity-checked (alignment, strictly growing, bounded step) since the 
+ * chain is read from a possibly broken stack.
+ */
+inline std::size_t walk_frame_pointers(const context_type& ctx, address_type* buffer, std::size_t size)
+{
+    static const std::size_t max_frame_size = 1024 * 1024;
+
+    std::size_t depth = 0;
+    address_type pc = get_context_pc(ctx);
+    if (pc == null_address || size == 0)
+    {
+        return 0;
+    }
+    buffer[depth++] = pc;
+
+    std::size_t sp = get_context_sp(ctx);
+    std::size_t fp = get_context_fp(ctx);
+    while (depth < size)
+    {
+        if (fp == 0 || fp < sp || (fp & (sizeof(std::size_t) - 1)) || fp - sp > max_frame_size)
+            break;
+
+        // [fp] = caller's fp; [fp + 1 word] = return address
+        const std::size_t* frame = reinterpret_cast<const std::size_t*>(fp);
+        std::size_t ret = frame[1];
+        if (ret == 0)
+            break;
+        buffer[depth++] = reinterpret_cast<address_type>(ret);
+
+        sp = fp + 2 * sizeof(std::size_t);
+        fp = frame[0];
+    }
+
+    return depth;
+}
+
+/**
+ * Capture the stack of the calling thread starting at the frame interrupted
+ * by a signal, given the context received by the signal handler.  The 
+ * handler and the signal trampoline frames are not part of the stack.
+ */
+template < class CallFrame,
+           std::size_t MaxDepth >
+std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack, const context_type& ctx)
+{
+    BOOST_STATIC_ASSERT_MSG((boost::is_base_of<call_frame_impl, CallFrame>::value), "CallFrame must inherit call_frame_impl");
+
+    // Room for the frames of the signal handler itself
+    static const std::size_t slack = 32;
+    address_type buffer[MaxDepth + slack] = {0};
+
+    // The unwinder crosses the signal frame when the context is the one of 
+    // the signal being handled; find the interrupted instruction in there.
+    int numFrames = ::backtrace(buffer, static_cast<int>(MaxDepth + slack));
+    address_type pc = get_context_pc(ctx);
+    int first = 0;
+    while (first < numFrames && buffer[first] != pc)
+        ++first;
+
+    std::size_t depth = 0;
+    if (pc != null_address && first < numFrames)
+    {
+        for (int i = first; i < numFrames && depth < MaxDepth; ++i)
+        {
+            stack[depth++] = call_frame_impl(buffer[i]);
+        }
+    }
+    else
+    {
+        std::size_t num = walk_frame_pointers(ctx, buffer, MaxDepth);
+        for ( ; depth < num; ++depth)
+        {
+            stack[depth] = call_frame_impl(buffer[depth]);
+        }
+    }
+
+    return depth;
+}
+
+
 }}} //namespace boost::call_stack::detail
 
 
@@ -0,0 +1,333 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_THREADS_HPP)
+#define BOOST_CALL_STACK_GNU_THREADS_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/call_stack/detail/gnu/symbol.hpp>
+#include <boost/call_stack/detail/gnu/stack.hpp>
+
+#include <boost/static_assert.hpp>
+#include <boost/assert.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <dirent.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+/*
+ * Capture the stacks of other threads of the process: each one is sent a
+ * signal and captures its own stack in its signal handler.
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+typedef pid_t  thread_id_type;
+
+inline thread_id_type current_thread_id()
+{
+    return static_cast<thread_id_type>(::syscall(SYS_gettid));
+}
+
+/**
+ * @return monotonic time in nanoseconds.  Async-signal-safe.
+ */
+inline boost::uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<boost::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<boost::uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * @return the threads of this process, from /proc/self/task.
+ */
+inline std::vector<thread_id_type> list_threads()
+{
+    std::vector<thread_id_type> tids;
+    DIR* dir = ::opendir("/proc/self/task");
+    if (!dir)
+    {
+        return tids;
+    }
+    while (struct dirent* ent = ::readdir(dir))
+    {
+        if (ent->d_name[0] < '0' || ent->d_name[0] > '9')
+            continue;
+        tids.push_back(static_cast<thread_id_type>(std::atoi(ent->d_name)));
+    }
+    ::closedir(dir);
+    std::sort(tids.begin(), tids.end());
+    return tids;
+}
+
+/**
+ * @return the name of a thread of this process (see pthread_setname_np(3)).
+ */
+inline std::string thread_name(thread_id_type tid)
+{
+    std::string name;
+    std::ifstream comm(("/proc/self/task/" + boost::lexical_cast<std::string>(tid) + "/comm").c_str());
+    std::getline(comm, name);
+    return name;
+}
+
+/**
+ * Send a signal carrying a pointer to a thread of this process.
+ * @return true if successful.
+ */
+inline bool signal_thread(thread_id_type tid, int signo, void* payload)
+{
+    siginfo_t info;
+    std::memset(&info, 0, sizeof(info));
+    info.si_signo = signo;
+    info.si_code  = SI_QUEUE;
+    info.si_pid   = ::getpid();
+    info.si_uid   = ::getuid();
+    info.si_value.sival_ptr = payload;
+    return ::syscall(SYS_rt_tgsigqueueinfo, ::getpid(), tid, signo, &info) == 0;
+}
+
+
+/**
+ * Slots into which signalled threads capture their stacks.  Slots are
+ * never freed but recycled: a late signal handler never writes to freed
+ * memory.  Each request is numbered; the signal carries the slot index and
+ * the request number, and the handler writes to the slot only if it is
+ * still armed for that request, not for a later one.
+ */
+template < typename CallStack >
+class thread_capture
+{
+public:
+
+    typedef CallStack  stack_type;
+
+    enum slot_state
+    {
+        idle,
+        armed,
+        capturing,
+        done
+    };
+
+    static const std::size_t slot_bits = 12;
+    static const std::size_t max_slots = 1 << slot_bits;   ///< slots in use at once
+
+    struct slot_type
+    {
+        boost::atomic<std::size_t>  state;      ///< request << 2 | slot_state
+        stack_type                  stack;
+        boost::uint64_t             pause_ns;   ///< time spent in the signal handler
+        std::size_t                 index;      ///< in the pool
+        slot_type*                  next;
+
+        slot_type() : state(idle), pause_ns(0), index(0), next(nullptr) {}
+    };
+
+    /**
+     * Install the signal handler for signo.
+     * @return true if successful, false if signo has a handler already.
+     */
+    static bool install(int signo)
+    {
+        boost::mutex::scoped_lock lock(pool().mutex);
+
+        struct sigaction old;
+        if (::sigaction(signo, nullptr, &old) != 0)
+        {
+            return false;
+        }
+        if (old.sa_flags & SA_SIGINFO)
+        {
+            return old.sa_sigaction == &thread_capture::on_signal;
+        }
+        if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)
+        {
+            return false;
+        }
+
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &thread_capture::on_signal;
+        sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+        ::sigemptyset(&sa.sa_mask);
+        return ::sigaction(signo, &sa, nullptr) == 0;
+    }
+
+    /**
+     * @return a slot, nullptr if max_slots are in use.
+     */
+    static slot_type* acquire()
+    {
+        boost::mutex::scoped_lock lock(pool().mutex);
+        slot_type* slot = pool().free;
+        if (slot)
+        {
+            pool().free = slot->next;
+        }
+        else if (pool().count < max_slots)
+        {
+            slot = new slot_type();
+            slot->index = pool().count;
+            pool().slots[pool().count++].store(slot, boost::memory_order_release);
+        }
+        else
+        {
+            return nullptr;
+        }
+        slot->next = nullptr;
+        slot->pause_ns = 0;
+        slot->state.store(idle);
+        return slot;
+    }
+
+    static void release(slot_type* slot)
+    {
+        disarm(*slot);
+        boost::mutex::scoped_lock lock(pool().mutex);
+        slot->next = pool().free;
+        pool().free = slot;
+    }
+
+    /**
+     * Arm the slot and signal the thread.
+     * @return true if the signal was sent.
+     */
+    static bool request(slot_type& slot, thread_id_type tid, int signo)
+    {
+        const std::size_t number = ++pool().requests & (~std::size_t(0) >> slot_bits);
+        slot.state.store(_word(number, armed), boost::memory_order_release);
+        if (!signal_thread(tid, signo, reinterpret_cast<void*>((number << slot_bits) | slot.index)))
+        {
+            slot.state.store(_word(number, idle));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @return true if the stack was captured before the deadline.
+     */
+    static bool wait(slot_type& slot, boost::uint64_t deadline_ns)
+    {
+        while ((slot.state.load(boost::memory_order_acquire) & 3) != done)
+        {
+            if (monotonic_ns() >= deadline_ns)
+            {
+                return false;
+            }
+            struct timespec ts = { 0, 20000 };
+            ::nanosleep(&ts, nullptr);
+        }
+        return true;
+    }
+
+    /**
+     * Make sure no signal handler will write to the slot anymore.
+     */
+    static void disarm(slot_type& slot)
+    {
+        std::size_t word = slot.state.load(boost::memory_order_acquire);
+        while ((word & 3) == armed)
+        {
+            if (slot.state.compare_exchange_weak(word, (word & ~std::size_t(3)) | idle))
+            {
+                return;
+            }
+        }
+        while ((slot.state.load(boost::memory_order_acquire) & 3) == capturing)
+            ;
+    }
+
+private:
+
+    struct pool_type
+    {
+        boost::mutex                mutex;
+        slot_type*                  free;
+        std::size_t                 count;               ///< slots allocated
+        boost::atomic<slot_type*>   slots[max_slots];    ///< by index, for the handler
+        boost::atomic<std::size_t>  requests;
+
+        pool_type() : free(nullptr), count(0), requests(0)
+        {
+            for (std::size_t i = 0; i < max_slots; ++i)
+            {
+                slots[i].store(nullptr, boost::memory_order_relaxed);
+            }
+        }
+    };
+
+    static pool_type& pool()
+    {
+        static pool_type p;
+        return p;
+    }
+
+    static std::size_t _word(std::size_t number, slot_state state)
+    {
+        return (number << 2) | state;
+    }
+
+    static void on_signal(int /*signo*/, siginfo_t* info, void* context)
+    {
+        if (info->si_code != SI_QUEUE || info->si_pid != ::getpid())
+        {
+            return;
+        }
+        const std::size_t payload = reinterpret_cast<std::size_t>(info->si_value.sival_ptr);
+        const std::size_t number  = payload >> slot_bits;
+        slot_type* slot = pool().slots[payload & (max_slots - 1)].load(boost::memory_order_acquire);
+        std::size_t expected = _word(number, armed);
+        if (!slot || !slot->state.compare_exchange_strong(expected, _word(number, capturing)))
+        {
+            return; // Stale request
+        }
+
+        int saved_errno = errno;
+        boost::uint64_t start = monotonic_ns();
+        slot->stack.get_stack(*static_cast<const context_type*>(context));
+        slot->pause_ns = monotonic_ns() - start;
+        slot->state.store(_word(number, done), boost::memory_order_release);
+        errno = saved_errno;
+    }
+}; //thread_capture
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_THREADS_HPP)
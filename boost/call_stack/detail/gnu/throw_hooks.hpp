@@ -0,0 +1,133 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+
+#if !defined(BOOST_CALL_STACK_GNU_THROW_HOOKS_HPP)
+#define BOOST_CALL_STACK_GNU_THROW_HOOKS_HPP
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/atomic.hpp>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+#include <cstdlib>
+#include <typeinfo>
+
+
+/*
+ * Interposition of __cxa_throw(), called by every throw expression: it is
+ * defined by the program (in the one translation unit defining
+ * BOOST_CALL_STACK_DEFINE_THROW_HOOK), tells the observer then calls the
+ * C++ runtime's.  Rethrows (throw;) do not go through it.
+ */
+
+extern "C"
+{
+    /// Defined with the hook: tells whether it is in the program.
+    extern int boost_call_stack_throw_hook __attribute__((weak));
+}
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class throw_hooks
+{
+public:
+
+    typedef void (*throw_observer)(void* object, std::type_info* type);
+    typedef void (*cxa_throw_type)(void*, std::type_info*, void (*)(void*));
+
+    /**
+     * @return true if the hook is linked in the program.
+     */
+    static bool defined()
+    {
+        return &boost_call_stack_throw_hook != nullptr;
+    }
+
+    /**
+     * Set the observer, nullptr for none.  It is called on the throwing
+     * thread, before unwinding.
+     */
+    static void observe(throw_observer obs)
+    {
+        observer().store(obs, boost::memory_order_release);
+    }
+
+    static void on_throw(void* object, std::type_info* type)
+    {
+        throw_observer obs = observer().load(boost::memory_order_acquire);
+        if (obs)
+        {
+            obs(object, type);
+        }
+    }
+
+    static cxa_throw_type next()
+    {
+        static cxa_throw_type fn = reinterpret_cast<cxa_throw_type>(::dlsym(RTLD_NEXT, "__cxa_throw"));
+        return fn;
+    }
+
+private:
+
+    static boost::atomic<throw_observer>& observer()
+    {
+        static boost::atomic<throw_observer> obs(nullptr);
+        return obs;
+    }
+}; //throw_hooks
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#if defined(BOOST_CALL_STACK_DEFINE_THROW_HOOK)
+
+extern "C"
+{
+
+int boost_call_stack_throw_hook = 1;
+
+} // extern "C"
+
+// Defined where <cxxabi.h> declares it: g++ has a builtin declaration too.
+namespace __cxxabiv1
+{
+
+extern "C"
+void __cxa_throw(void* object, std::type_info* type, void (_GLIBCXX_CDTOR_CALLABI *destructor)(void*))
+{
+    boost::call_stack::detail::throw_hooks::on_throw(object, type);
+
+    boost::call_stack::detail::throw_hooks::cxa_throw_type next = boost::call_stack::detail::throw_hooks::next();
+    if (!next)
+    {
+        std::abort();
+    }
+    next(object, type, destructor);
+    std::abort();  // Never returns
+}
+
+} //namespace __cxxabiv1
+
+#endif //#if defined(BOOST_CALL_STACK_DEFINE_THROW_HOOK)
+
+
+#endif //#if !defined(BOOST_CALL_STACK_GNU_THROW_HOOKS_HPP)
@@ -45,6 +45,11 @@ template < class CallFrame,
            std::size_t MaxDepth >
 std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack);
 
+// define context_type: register state of an interrupted thread
+template < class CallFrame,
+           std::size_t MaxDepth >
+std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack, const context_type& ctx);
+
 class null_symbol_resolver;
 class basic_symbol_resolver;
 class extended_symbol_resolver;
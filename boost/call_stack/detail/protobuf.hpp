@@ -0,0 +1,235 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_PROTOBUF_HPP)
+#define BOOST_CALL_STACK_PROTOBUF_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/detail/config.hpp>
+
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+#  include <zlib.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+/*
+ * Just enough of the protocol buffers wire format to write messages, and a
+ * gzip stream to write them to.
+ */
+
+namespace boost { namespace call_stack { namespace detail {
+
+/*
+ *
+ */
+
+class proto_message
+{
+public:
+
+    enum wire_type
+    {
+        varint_wire    = 0,
+        delimited_wire = 2
+    };
+
+    void clear() { _buf.clear(); }
+
+    const std::string& str() const noexcept { return _buf; }
+
+    /**
+     * Integer field; zero (the default) is not written.
+     */
+    proto_message& add(int field, boost::uint64_t value)
+    {
+        if (value)
+        {
+            _key(field, varint_wire);
+            _varint(value);
+        }
+        return *this;
+    }
+
+    proto_message& add_signed(int field, boost::int64_t value)
+    {
+        return add(field, static_cast<boost::uint64_t>(value));
+    }
+
+    /**
+     * String, bytes or embedded message field.
+     */
+    proto_message& add(int field, const char* data, std::size_t len)
+    {
+        _key(field, delimited_wire);
+        _varint(len);
+        _buf.append(data, len);
+        return *this;
+    }
+
+    proto_message& add(int field, const std::string& data)
+    {
+        return add(field, data.data(), data.size());
+    }
+
+    proto_message& add(int field, const proto_message& msg)
+    {
+        return add(field, msg.str());
+    }
+
+    /**
+     * Packed repeated integer field.
+     */
+    proto_message& add_packed(int field, const std::vector<boost::uint64_t>& values)
+    {
+        if (values.empty())
+        {
+            return *this;
+        }
+        _scratch.clear();
+        _scratch.swap(_buf);
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            _varint(values[i]);
+        }
+        _scratch.swap(_buf);
+        return add(field, _scratch);
+    }
+
+private:
+
+    void _key(int field, wire_type type)
+    {
+        _varint((static_cast<boost::uint64_t>(field) << 3) | type);
+    }
+
+    void _varint(boost::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            _buf += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        _buf += static_cast<char>(value);
+    }
+
+private:
+
+    std::string  _buf;
+    std::string  _scratch;
+}; //proto_message
+
+
+/**
+ * Writes gzip-compressed data to a stream, or uncompressed data if zlib
+ * is not available (BOOST_CALL_STACK_NO_ZLIB).
+ */
+class gzip_sink : private boost::noncopyable
+{
+public:
+
+    explicit gzip_sink(std::ostream& os)
+        : _os(os)
+        , _done(false)
+    {
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+        std::memset(&_zs, 0, sizeof(_zs));
+        // 15 + 16: gzip header and trailer
+        _ok = (::deflateInit2(&_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+#endif
+    }
+
+    ~gzip_sink()
+    {
+        finish();
+    }
+
+    void write(const std::string& data)
+    {
+        write(data.data(), data.size());
+    }
+
+    void write(const char* data, std::size_t len)
+    {
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+        if (_ok && len)
+        {
+            _zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            _zs.avail_in = static_cast<uInt>(len);
+            _deflate(Z_NO_FLUSH);
+        }
+#else
+        _os.write(data, static_cast<std::streamsize>(len));
+#endif
+    }
+
+    /**
+     * Write the gzip trailer; nothing can be written afterwards.
+     */
+    void finish()
+    {
+        if (_done)
+        {
+            return;
+        }
+        _done = true;
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+        if (_ok)
+        {
+            _zs.next_in  = nullptr;
+            _zs.avail_in = 0;
+            _deflate(Z_FINISH);
+            ::deflateEnd(&_zs);
+        }
+#endif
+        _os.flush();
+    }
+
+private:
+
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+    void _deflate(int flush)
+    {
+        char out[16384];
+        int  ret = Z_OK;
+        do
+        {
+            _zs.next_out  = reinterpret_cast<Bytef*>(out);
+            _zs.avail_out = sizeof(out);
+            ret = ::deflate(&_zs, flush);
+            _os.write(out, static_cast<std::streamsize>(sizeof(out) - _zs.avail_out));
+        } while (_zs.avail_out == 0 || (flush == Z_FINISH && ret == Z_OK));
+    }
+#endif
+
+private:
+
+    std::ostream&  _os;
+    bool           _done;
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+    z_stream       _zs;
+    bool           _ok;
+#endif
+}; //gzip_sink
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_PROTOBUF_HPP)
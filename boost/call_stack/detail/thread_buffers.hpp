@@ -0,0 +1,119 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_THREAD_BUFFERS_HPP)
+#define BOOST_CALL_STACK_THREAD_BUFFERS_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#if !defined(BOOST_CALL_STACK_HPP)
+#  error "This header cannot be included directly. Include <boost/call_stack/call_stack.hpp>"
+#endif
+
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+
+namespace boost { namespace call_stack { namespace detail {
+
+/**
+ * The buffers of one owner, one per thread: a thread finds its own without
+ * locking; readers list all of them under a lock.  The buffers outlive
+ * their threads and are released with the owner.
+ *
+ * @tparam Buffer Constructed from the capacity given to the owner.
+ */
+template < typename Buffer >
+class thread_buffers : private boost::noncopyable
+{
+public:
+
+    typedef boost::shared_ptr<Buffer>  buffer_ptr;
+
+    explicit thread_buffers(std::size_t capacity)
+        : _serial(++serial_counter())
+        , _capacity(capacity)
+    {}
+
+    /**
+     * @return the buffer of the calling thread, made on its first call.
+     */
+    Buffer& local()
+    {
+        local_buffers_type& mine = local_buffers();
+        typename local_buffers_type::iterator it = mine.find(_serial);
+        if (it != mine.end())
+        {
+            return *it->second;
+        }
+
+        buffer_ptr buf(new Buffer(_capacity));
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _buffers.push_back(buf);
+        }
+        mine[_serial] = buf.get();
+        return *buf;
+    }
+
+    /**
+     * @return the buffers of all the threads so far.
+     */
+    std::vector<buffer_ptr> all() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _buffers;
+    }
+
+private:
+
+    typedef std::map< unsigned long, Buffer* >  local_buffers_type;   ///< by owner serial
+
+    static boost::atomic<unsigned long>& serial_counter()
+    {
+        static boost::atomic<unsigned long> counter(0);
+        return counter;
+    }
+
+    /*
+     * Buffers of the calling thread, for all the owners; serials are never
+     * reused, so a destroyed owner is never found again.
+     */
+    static local_buffers_type& local_buffers()
+    {
+        static boost::thread_specific_ptr< local_buffers_type > buffers;
+        if (!buffers.get())
+        {
+            buffers.reset(new local_buffers_type());
+        }
+        return *buffers;
+    }
+
+    const unsigned long      _serial;
+    const std::size_t        _capacity;
+
+    mutable boost::mutex     _mutex;     ///< guards _buffers
+    std::vector<buffer_ptr>  _buffers;
+}; //thread_buffers
+
+
+}}} //namespace boost::call_stack::detail
+
+
+#endif //#if !defined(BOOST_CALL_STACK_THREAD_BUFFERS_HPP)
@@ -318,7 +318,8 @@ public:
         return _shutdown();
     }
 
-    int backtrace(DWORD64* buffer, int size)
+    // Start at the given context if any, otherwise at the caller's frame.
+    int backtrace(DWORD64* buffer, int size, const CONTEXT* from = NULL)
     {
         boost::mutex::scoped_lock lock(_lib_mutex);
 
@@ -332,8 +333,13 @@ public:
         
         // Alternative: call ImageNtHeader() and use machine info from PE header
         CONTEXT ctx = {0};
-        ctx.ContextFlags = CONTEXT_FULL;
-        ::RtlCaptureContext(&ctx);
+        if (from) {
+            ctx = *from; // StackWalk64 modifies it
+        }
+        else {
+            ctx.ContextFlags = CONTEXT_FULL;
+            ::RtlCaptureContext(&ctx);
+        }
         
         STACKFRAME64 sf;
         init_stackframe<CONTEXT>(sf, ctx);
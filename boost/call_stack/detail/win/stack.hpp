@@ -54,6 +54,34 @@ std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack)
 }
 
 
+/*
+ * Register state of a thread, as passed to an exception filter.
+ */
+
+typedef CONTEXT  context_type;
+
+/**
+ * Capture the stack starting at the frame described by the given context
+ * (e.g. from the EXCEPTION_POINTERS of an exception filter).
+ */
+template < class CallFrame,
+           std::size_t MaxDepth >
+std::size_t get_stack(boost::array<CallFrame, MaxDepth>& stack, const context_type& ctx)
+{
+    BOOST_STATIC_ASSERT_MSG((boost::is_base_of<call_frame_impl, CallFrame>::value), "CallFrame must inherit call_frame_impl");
+    address_type buffer[MaxDepth] = {0};
+
+    int numFrames = dbghelp::dbghelp_lib_type::instance().backtrace(buffer, MaxDepth, &ctx);
+    BOOST_ASSERT(numFrames >= 0 && numFrames <= MaxDepth);
+    for (int i=0; i<numFrames; ++i)
+    {
+        stack[i] = call_frame_impl(buffer[i]);
+    }
+
+    return static_cast<std::size_t>(numFrames);
+}
+
+
 }}} //namespace boost::call_stack::detail
 
 
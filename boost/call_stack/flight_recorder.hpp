@@ -0,0 +1,234 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_FLIGHT_RECORDER_HPP)
+#define BOOST_CALL_STACK_FLIGHT_RECORDER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/detail/thread_buffers.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Flight recorder: keeps, for each thread, the last events it recorded with
+ * their call stacks, to be dumped after an incident.
+ *
+ * Each thread writes to its own ring: recording an event is a stack capture
+ * and a few stores, without locks nor allocations (but the first event of a
+ * thread).  The rings outlive their threads and are dumped, oldest events
+ * first, with each distinct address resolved once.  Dumping while threads
+ * record skips the events being overwritten.
+ *
+ * Timestamps are CPU timestamp counter ticks on x86 (monotonic nanoseconds
+ * elsewhere), converted at dump time.  Tags must outlive the recorder (e.g.
+ * string literals).  GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class flight_recorder : private boost::noncopyable
+{
+public:
+
+    typedef CallStack  stack_type;
+
+    struct event_type
+    {
+        boost::uint64_t  ticks;
+        const char*      tag;
+        boost::uint64_t  value;    ///< user data
+        stack_type       stack;
+    };
+
+    /**
+     * @param capacity Events kept per thread.
+     */
+    explicit flight_recorder(std::size_t capacity = 256)
+        : _capacity(capacity ? capacity : 1)
+        , _start_ticks(ticks())
+        , _start_ns(detail::monotonic_ns())
+        , _rings(_capacity)
+    {}
+
+    /**
+     * Record an event of the calling thread, with its call stack.
+     */
+    void record(const char* tag, boost::uint64_t value = 0)
+    {
+        ring_type& ring = _rings.local();
+        const boost::uint64_t pos  = ring.head.load(boost::memory_order_relaxed);
+        slot_type&            slot = ring.slots[pos % _capacity];
+
+        // Readers skip the slot while its sequence is odd
+        slot.seq.store(2 * pos + 1, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        slot.event.ticks = ticks();
+        slot.event.tag   = tag ? tag : "";
+        slot.event.value = value;
+        slot.event.stack.get_stack();
+        slot.seq.store(2 * pos + 2, boost::memory_order_release);
+        ring.head.store(pos + 1, boost::memory_order_release);
+    }
+
+    /**
+     * @return the events kept for each thread, oldest first, by thread id.
+     */
+    std::map< detail::thread_id_type, std::vector<event_type> > events() const
+    {
+        typedef std::vector< boost::shared_ptr<ring_type> >  rings_type;
+
+        std::map< detail::thread_id_type, std::vector<event_type> > ret;
+        const rings_type rings = _rings.all();
+        for (std::size_t r = 0; r < rings.size(); ++r)
+        {
+            _read(*rings[r], ret[rings[r]->tid]);
+        }
+        return ret;
+    }
+
+    /**
+     * Write the events of each thread, oldest first, with their times
+     * relative to now, their stacks and symbols.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    void dump(std::ostream& os) const
+    {
+        typedef std::map< detail::thread_id_type, std::vector<event_type> >  threads_type;
+
+        const threads_type     threads = events();
+        const boost::uint64_t  now     = ticks();
+        const double           ns_per_tick = _ns_per_tick(now);
+
+        symbol_cache< AddrResolver > cache;
+        for (typename threads_type::const_iterator th = threads.begin(); th != threads.end(); ++th)
+        {
+            os << "Thread " << std::dec << th->first << ": " << th->second.size() << " events\n";
+            for (std::size_t e = 0; e < th->second.size(); ++e)
+            {
+                const event_type& ev = th->second[e];
+                char when[64];
+                std::snprintf(when, sizeof(when), "%.3f", -static_cast<double>(now - ev.ticks) * ns_per_tick / 1000000.0);
+                os << "  [" << when << " ms] " << ev.tag << " " << ev.value << "\n";
+                for (typename stack_type::const_iterator frm = ev.stack.begin(); frm != ev.stack.end(); ++frm)
+                {
+                    os << "    ";
+                    OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                    os << "\n";
+                }
+            }
+        }
+        os << std::flush;
+    }
+
+    std::size_t capacity() const noexcept { return _capacity; }
+
+    /**
+     * @return the current timestamp, in the unit of event_type::ticks.
+     */
+    static boost::uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return detail::monotonic_ns();
+#endif
+    }
+
+private:
+
+    struct slot_type
+    {
+        boost::atomic<boost::uint64_t>  seq;     ///< 2 * position + 2 once written
+        event_type                      event;
+
+        slot_type() : seq(0) {}
+    };
+
+    struct ring_type
+    {
+        detail::thread_id_type          tid;
+        boost::atomic<boost::uint64_t>  head;    ///< events recorded
+        boost::scoped_array<slot_type>  slots;
+
+        explicit ring_type(std::size_t capacity)
+            : tid(detail::current_thread_id())
+            , head(0)
+            , slots(new slot_type[capacity])
+        {}
+    };
+
+    void _read(const ring_type& ring, std::vector<event_type>& out) const
+    {
+        const boost::uint64_t head  = ring.head.load(boost::memory_order_acquire);
+        const boost::uint64_t first = head > _capacity ? head - _capacity : 0;
+        for (boost::uint64_t pos = first; pos < head; ++pos)
+        {
+            const slot_type& slot = ring.slots[pos % _capacity];
+            if (slot.seq.load(boost::memory_order_acquire) != 2 * pos + 2)
+            {
+                continue;
+            }
+            event_type ev = slot.event;
+            boost::atomic_thread_fence(boost::memory_order_acquire);
+            if (slot.seq.load(boost::memory_order_relaxed) == 2 * pos + 2)
+            {
+                out.push_back(ev);
+            }
+        }
+    }
+
+    double _ns_per_tick(boost::uint64_t now) const
+    {
+        const boost::uint64_t ns = detail::monotonic_ns() - _start_ns;
+        const boost::uint64_t tk = now - _start_ticks;
+        return (tk && ns) ? static_cast<double>(ns) / static_cast<double>(tk) : 1.0;
+    }
+
+private:
+
+    const std::size_t                        _capacity;
+    const boost::uint64_t                    _start_ticks;
+    const boost::uint64_t                    _start_ns;
+
+    detail::thread_buffers<ring_type>        _rings;
+}; //flight_recorder
+
+
+typedef flight_recorder< default_stack >  default_flight_recorder;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_FLIGHT_RECORDER_HPP)
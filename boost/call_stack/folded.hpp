@@ -0,0 +1,167 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_FOLDED_HPP)
+#define BOOST_CALL_STACK_FOLDED_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Writes call stacks in the folded format of Brendan Gregg's FlameGraph
+ * tools (flamegraph.pl, speedscope, inferno...): one line per stack, the
+ * frames from the outermost to the innermost separated by ';', then a
+ * space and a count:
+ *
+ * \code
+ * main;run;parse;strtol 42
+ * \endcode
+ *
+ * Each distinct address is resolved once across all the stacks written,
+ * and lines are written as they come: nothing but the names of the
+ * functions is kept.  Frames without a symbol are named after their binary
+ * ([binary]) or [unknown].  Stacks written several times make several
+ * lines; the tools add them up.
+ *
+ * @tparam AddrResolver    See \ref symbol_resolver
+ */
+template < typename AddrResolver >
+class folded_stack_writer : private boost::noncopyable
+{
+public:
+
+    typedef AddrResolver  symbol_resolver_type;
+    typedef boost::unordered_map< address_type
+                                , std::string
+                                , boost::hash<address_type> >  names_type;
+    typedef typename names_type::size_type                     size_type;
+
+    explicit folded_stack_writer(std::ostream& os)
+        : _os(os)
+    {}
+
+    /**
+     * Write one line: stack and value.  Empty stacks are skipped.
+     */
+    template < typename CallStack >
+    void write(const CallStack& stack, boost::uint64_t value)
+    {
+        if (stack.empty())
+        {
+            return;
+        }
+
+        _line.clear();
+        for (typename CallStack::size_type i = stack.depth(); i-- > 0; )
+        {
+            _line += _name(stack[i].addr());
+            _line += (i ? ';' : ' ');
+        }
+        _append_dec(value);
+        _line += '\n';
+        _os.write(_line.data(), static_cast<std::streamsize>(_line.size()));
+    }
+
+    /**
+     * Write a whole profile, with the sample counts or the weights.
+     */
+    template < typename CallStack >
+    void write(const stack_profile<CallStack>& profile, bool weights = false)
+    {
+        typedef typename stack_profile<CallStack>::const_iterator  const_iterator;
+        for (const_iterator it = profile.begin(); it != profile.end(); ++it)
+        {
+            write(it->first, weights ? it->second.weight : it->second.count);
+        }
+        _os.flush();
+    }
+
+    /**
+     * @return the number of distinct addresses resolved so far.
+     */
+    size_type symbols() const noexcept { return _names.size(); }
+
+private:
+
+    const std::string& _name(const address_type& addr)
+    {
+        typename names_type::iterator it = _names.find(addr);
+        if (it != _names.end())
+        {
+            return it->second;
+        }
+
+        // Resolvers re-resolve when copied: resolve in place.
+        symbol_resolver_type sym;
+        sym.resolve(addr);
+
+        std::string name(sym.demangled_name());
+        if (name == "??")
+        {
+            const char* binary = sym.binary_file();
+            const char* slash  = std::strrchr(binary, '/');
+            name = (std::strcmp(binary, "??") != 0) ? std::string("[") + (slash ? slash + 1 : binary) + "]"
+                                                     : std::string("[unknown]");
+        }
+        std::replace(name.begin(), name.end(), ';', ':');  // The frame separator
+        std::replace(name.begin(), name.end(), '\n', ' ');
+
+        return _names.insert(typename names_type::value_type(addr, name)).first->second;
+    }
+
+    void _append_dec(boost::uint64_t value)
+    {
+        fixed_output_buffer<24> digits;
+        digits.append_dec(value);
+        _line.append(digits.c_str(), digits.size());
+    }
+
+private:
+
+    std::ostream&  _os;
+    names_type     _names;
+    std::string    _line;
+}; //folded_stack_writer
+
+
+/**
+ * Write a profile in folded format, see \ref folded_stack_writer.
+ */
+template < typename AddrResolver, typename CallStack > inline
+void write_folded(std::ostream& os, const stack_profile<CallStack>& profile, bool weights = false)
+{
+    folded_stack_writer< AddrResolver > writer(os);
+    writer.write(profile, weights);
+}
+
+
+typedef folded_stack_writer< default_symbol_resolver >  default_folded_stack_writer;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_FOLDED_HPP)
@@ -164,6 +164,16 @@ public:
         return s.str();
     }
 
+    /**
+     * Allocation-free alternative to \ref as_string(); the symbol resolver
+     * might still allocate.  @see output_buffer
+     */
+    output_buffer& format(output_buffer& buf) const
+    {
+        call_frame_formatter_type:: template print< symbol_resolver_type >(_frame, buf);
+        return buf;
+    }
+
     bool operator==(call_frame_info const& other) const noexcept
     {
         return _frame == other._frame; 
@@ -199,6 +209,27 @@ struct terse_call_frame_formatter
     {
         terse_symbol_formatter::print<AddrResolver>(frm.addr(), os);
     }
+
+    /**
+     * Same as above, with the symbol information already resolved.
+     */
+    template < typename AddrResolver >
+    static void print(call_frame const& /*frm*/, AddrResolver const& sym, std::ostream& os)
+    {
+        terse_symbol_formatter::print<AddrResolver>(sym, os);
+    }
+
+    template < typename AddrResolver >
+    static void print(call_frame const& frm, output_buffer& buf)
+    {
+        terse_symbol_formatter::print<AddrResolver>(frm.addr(), buf);
+    }
+
+    template < typename AddrResolver >
+    static void print(call_frame const& /*frm*/, AddrResolver const& sym, output_buffer& buf)
+    {
+        terse_symbol_formatter::print<AddrResolver>(sym, buf);
+    }
 };
 
 
@@ -212,9 +243,116 @@ struct fancy_call_frame_formatter
     {
         fancy_symbol_formatter::print<AddrResolver>(frm.addr(), os);
     }
+
+    /**
+     * Same as above, with the symbol information already resolved.
+     */
+    template < typename AddrResolver >
+    static void print(call_frame const& /*frm*/, AddrResolver const& sym, std::ostream& os)
+    {
+        fancy_symbol_formatter::print<AddrResolver>(sym, os);
+    }
+
+    template < typename AddrResolver >
+    static void print(call_frame const& frm, output_buffer& buf)
+    {
+        fancy_symbol_formatter::print<AddrResolver>(frm.addr(), buf);
+    }
+
+    template < typename AddrResolver >
+    static void print(call_frame const& /*frm*/, AddrResolver const& sym, output_buffer& buf)
+    {
+        fancy_symbol_formatter::print<AddrResolver>(sym, buf);
+    }
 };
 
 
+/**
+ * A \ref call_frame with its symbol information already resolved. A
+ * lightweight view: the symbol information is owned by the container
+ * that resolved it (see \ref resolved_call_stack_info) and must outlive
+ * this object.
+ *
+ * @tparam AddrResolver    See \ref symbol_resolver
+ * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+ */
+
+template < typename AddrResolver
+         , typename OutputFormatter
+         >
+class resolved_call_frame_info
+{
+public:
+
+    typedef AddrResolver           symbol_resolver_type;
+    typedef OutputFormatter        call_frame_formatter_type;
+
+    resolved_call_frame_info() noexcept
+        : _frame(null_frame)
+        , _sym(nullptr)
+    {}
+
+    resolved_call_frame_info(const call_frame& frame, const symbol_resolver_type& sym) noexcept
+        : _frame(frame)
+        , _sym(&sym)
+    {}
+
+    void swap(resolved_call_frame_info& other) noexcept
+    {
+        std::swap(_frame, other._frame);
+        std::swap(_sym,   other._sym);
+    }
+
+    call_frame frame() const 
+    {
+        return _frame;
+    }
+
+    const symbol_resolver_type& symbol() const 
+    {
+        BOOST_ASSERT(_sym);
+        return *_sym;
+    }
+
+    friend inline std::ostream& operator<<(std::ostream& os,
+                                           const resolved_call_frame_info& frm)
+    {
+        call_frame_formatter_type:: template print< symbol_resolver_type >(frm._frame, frm.symbol(), os);
+        return os;
+    }
+
+    std::string as_string() const
+    {
+        std::ostringstream s;
+        s << *this;
+        return s.str();
+    }
+
+    /**
+     * Allocation-free alternative to \ref as_string(). @see output_buffer
+     */
+    output_buffer& format(output_buffer& buf) const
+    {
+        call_frame_formatter_type:: template print< symbol_resolver_type >(_frame, symbol(), buf);
+        return buf;
+    }
+
+    bool operator==(resolved_call_frame_info const& other) const noexcept
+    {
+        return _frame == other._frame; 
+    }
+    bool operator!=(resolved_call_frame_info const& other) const noexcept
+    {
+        return !(_frame == other._frame); 
+    }
+
+private:
+
+    call_frame                   _frame;
+    const symbol_resolver_type*  _sym;
+}; //resolved_call_frame_info
+
+
 }} //namespace boost::call_stack
 
 
@@ -239,6 +377,16 @@ void swap(boost::call_stack::call_frame_info< AddrResolver, OutputFormatter >& l
 }
 
 
+template < typename AddrResolver
+         , typename OutputFormatter
+         > inline
+void swap(boost::call_stack::resolved_call_frame_info< AddrResolver, OutputFormatter >& left, 
+          boost::call_stack::resolved_call_frame_info< AddrResolver, OutputFormatter >& right) noexcept
+{
+    left.swap(right);
+}
+
+
 } //namespace std
 
 #endif //#if !defined(BOOST_CALL_STACK_FRAME_HPP)
@@ -0,0 +1,405 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_HEAP_PROFILER_HPP)
+#define BOOST_CALL_STACK_HEAP_PROFILER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+#include <boost/call_stack/pprof.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/malloc_hooks.hpp>
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <new>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Sampling heap profiler: captures the call stack of about one allocation
+ * per sample_bytes allocated, tracks the sampled blocks until freed and
+ * estimates from them the heap in use and allocated, by stack.
+ *
+ * Each thread counts down the bytes it allocates from a random, exponentially
+ * distributed, distance (mean sample_bytes); the allocation crossing zero is
+ * sampled.  Big allocations are thus more likely sampled, and a sample of
+ * size bytes stands for 1 / (1 - exp(-size / sample_bytes)) allocations of
+ * that size.  Unsampled allocations cost a thread-local subtraction;
+ * deallocations a lookup in a small table of counters, but for those of
+ * sampled blocks.
+ *
+ * Allocations are seen through the malloc hooks, as for \ref
+ * basic_leak_checker: define BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS before
+ * including this header in exactly one translation unit of the program.
+ *
+ * GCC on Linux (glibc) only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_heap_profiler
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+
+    /**
+     * Start sampling allocations.
+     * @param sample_bytes Mean number of bytes allocated between samples.
+     * @return false if the malloc hooks are not in the program.
+     */
+    static bool start(std::size_t sample_bytes = 512 * 1024)
+    {
+        if (!detail::malloc_hooks::defined())
+        {
+            return false;
+        }
+        state();  // Construct it now rather than in a hook
+        _sample_bytes() = sample_bytes ? sample_bytes : 1;
+        if (!_registered().exchange(true))
+        {
+            // Frees are always observed: a sampled block stays tracked until freed
+            if (!detail::malloc_hooks::add(&basic_heap_profiler::_on_alloc, &basic_heap_profiler::_on_free))
+            {
+                _registered() = false;
+                return false;
+            }
+        }
+        _started() = true;
+        return true;
+    }
+
+    /**
+     * Stop sampling allocations.  The blocks sampled so far stay tracked
+     * until freed.
+     */
+    static void stop()
+    {
+        _started() = false;
+    }
+
+    static bool running()
+    {
+        return _started().load();
+    }
+
+    static std::size_t sample_bytes()
+    {
+        return _sample_bytes().load();
+    }
+
+    /**
+     * @return the estimated heap in use, by allocation stack: count is the
+     * number of blocks, weight their size in bytes.
+     */
+    static profile_type inuse_profile()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        state_type& st = state();
+
+        estimates_type by_id;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            const blocks_type& blocks = st.shards[i].blocks;
+            for (typename blocks_type::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+            {
+                by_id[it->second.stack_id].add(it->second.size, it->second.scale);
+            }
+        }
+        return _profile(st, by_id);
+    }
+
+    /**
+     * @return the estimated allocations since start() or \ref clear(), by
+     * allocation stack: count is the number of blocks, weight their size in
+     * bytes.
+     */
+    static profile_type allocated_profile()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        state_type& st = state();
+
+        estimates_type by_id;
+        {
+            boost::mutex::scoped_lock lock(st.allocated_mutex);
+            by_id = st.allocated;
+        }
+        return _profile(st, by_id);
+    }
+
+    /**
+     * @return the number of sampled blocks not freed yet.
+     */
+    static std::size_t sampled_blocks()
+    {
+        state_type& st = state();
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            ret += st.shards[i].blocks.size();
+        }
+        return ret;
+    }
+
+    /**
+     * Forget the allocations so far; sampled blocks in use stay tracked.
+     */
+    static void clear()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        state_type& st = state();
+        boost::mutex::scoped_lock lock(st.allocated_mutex);
+        st.allocated.clear();
+    }
+
+    /**
+     * Write the heap in use, or the allocations, in pprof format, see \ref
+     * pprof_writer.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     */
+    template < typename AddrResolver >
+    static void dump(std::ostream& os, bool inuse = true)
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        const profile_type profile = inuse ? inuse_profile() : allocated_profile();
+        write_pprof< AddrResolver >(os, profile, inuse ? "inuse_space" : "alloc_space", "bytes", sample_bytes());
+    }
+
+private:
+
+    static const std::size_t shard_bits  = 4;
+    static const std::size_t shard_count = 1 << shard_bits;
+    static const std::size_t filter_bits = 12;
+    static const std::size_t filter_size = 1 << filter_bits;
+
+    struct block_type
+    {
+        std::size_t    size;
+        double         scale;      ///< allocations the sample stands for
+        stack_id_type  stack_id;
+    };
+
+    struct estimate_type
+    {
+        double  count;
+        double  bytes;
+
+        estimate_type() : count(0), bytes(0) {}
+
+        void add(std::size_t size, double scale)
+        {
+            count += scale;
+            bytes += scale * static_cast<double>(size);
+        }
+    };
+
+    typedef boost::unordered_map< void*, block_type >              blocks_type;
+    typedef boost::unordered_map< stack_id_type, estimate_type >   estimates_type;
+
+    struct shard_type
+    {
+        boost::mutex   mutex;
+        blocks_type    blocks;
+    };
+
+    struct state_type
+    {
+        depot_type                       depot;
+        shard_type                       shards[shard_count];
+        boost::atomic<boost::uint32_t>   filter[filter_size];   ///< sampled blocks by address hash
+        boost::mutex                     allocated_mutex;
+        estimates_type                   allocated;
+
+        state_type()
+        {
+            for (std::size_t i = 0; i < filter_size; ++i)
+            {
+                filter[i].store(0, boost::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct thread_state
+    {
+        boost::int64_t   remaining;   ///< bytes until the next sample
+        boost::uint64_t  rng;         ///< 0: not seeded yet
+    };
+
+    /*
+     * Never destroyed: frees happen until the very end of the process.
+     */
+    static state_type& state()
+    {
+        static state_type* st = _create();
+        return *st;
+    }
+
+    static state_type* _create()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        static typename boost::aligned_storage< sizeof(state_type)
+                                              , boost::alignment_of<state_type>::value >::type storage;
+        return new (&storage) state_type();
+    }
+
+    static thread_state& _thread_state()
+    {
+        static __thread thread_state ts = { 0, 0 };
+        return ts;
+    }
+
+    static shard_type& _shard(void* ptr)
+    {
+        return state().shards[(reinterpret_cast<std::size_t>(ptr) >> 4) & (shard_count - 1)];
+    }
+
+    static boost::atomic<boost::uint32_t>& _filter(void* ptr)
+    {
+        const std::size_t p = reinterpret_cast<std::size_t>(ptr);
+        return state().filter[((p >> 4) ^ (p >> (4 + filter_bits))) & (filter_size - 1)];
+    }
+
+    /*
+     * Exponentially distributed distance to the next sample.
+     */
+    static boost::int64_t _next_distance(thread_state& ts)
+    {
+        ts.rng ^= ts.rng << 13;   // xorshift64
+        ts.rng ^= ts.rng >> 7;
+        ts.rng ^= ts.rng << 17;
+        const double u = static_cast<double>(ts.rng >> 11) * (1.0 / 9007199254740992.0);   // [0, 1)
+        const double mean = static_cast<double>(_sample_bytes().load(boost::memory_order_relaxed));
+        return static_cast<boost::int64_t>(-std::log(1.0 - u) * mean) + 1;
+    }
+
+    static void _on_alloc(void* ptr, std::size_t size)
+    {
+        if (!_started().load(boost::memory_order_relaxed))
+        {
+            return;
+        }
+
+        thread_state& ts = _thread_state();
+        if (!ts.rng)
+        {
+            ts.rng = (static_cast<boost::uint64_t>(detail::current_thread_id()) << 32) ^ detail::monotonic_ns();
+            ts.rng = ts.rng ? ts.rng : 1;
+            ts.remaining = _next_distance(ts);
+        }
+        ts.remaining -= static_cast<boost::int64_t>(size);
+        if (ts.remaining > 0)
+        {
+            return;
+        }
+        ts.remaining = _next_distance(ts);
+
+        const double mean = static_cast<double>(_sample_bytes().load(boost::memory_order_relaxed));
+        const double prob = 1.0 - std::exp(-static_cast<double>(size) / mean);
+
+        stack_type stack;
+        stack.get_stack();
+        block_type block;
+        block.size     = size;
+        block.scale    = prob > 0 ? 1.0 / prob : 1.0;
+        block.stack_id = state().depot.intern(stack);
+
+        {
+            shard_type& shard = _shard(ptr);
+            boost::mutex::scoped_lock lock(shard.mutex);
+            shard.blocks[ptr] = block;
+        }
+        _filter(ptr).fetch_add(1, boost::memory_order_release);
+        {
+            boost::mutex::scoped_lock lock(state().allocated_mutex);
+            state().allocated[block.stack_id].add(size, block.scale);
+        }
+    }
+
+    static void _on_free(void* ptr)
+    {
+        boost::atomic<boost::uint32_t>& filter = _filter(ptr);
+        if (!filter.load(boost::memory_order_acquire))
+        {
+            return;  // Not sampled: the common case
+        }
+
+        shard_type& shard = _shard(ptr);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename blocks_type::iterator it = shard.blocks.find(ptr);
+        if (it != shard.blocks.end())
+        {
+            shard.blocks.erase(it);
+            filter.fetch_sub(1, boost::memory_order_relaxed);
+        }
+    }
+
+    static profile_type _profile(const state_type& st, const estimates_type& by_id)
+    {
+        profile_type ret;
+        for (typename estimates_type::const_iterator it = by_id.begin(); it != by_id.end(); ++it)
+        {
+            ret.add(st.depot.get(it->first),
+                    sample_value(static_cast<boost::uint64_t>(it->second.count + 0.5),
+                                 static_cast<boost::uint64_t>(it->second.bytes + 0.5)));
+        }
+        return ret;
+    }
+
+    static boost::atomic<bool>& _started()
+    {
+        static boost::atomic<bool> started(false);
+        return started;
+    }
+
+    static boost::atomic<bool>& _registered()
+    {
+        static boost::atomic<bool> registered(false);
+        return registered;
+    }
+
+    static boost::atomic<std::size_t>& _sample_bytes()
+    {
+        static boost::atomic<std::size_t> bytes(512 * 1024);
+        return bytes;
+    }
+}; //basic_heap_profiler
+
+
+typedef basic_heap_profiler< default_stack >  default_heap_profiler;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_HEAP_PROFILER_HPP)
@@ -0,0 +1,300 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_INSTANCE_TRACKER_HPP)
+#define BOOST_CALL_STACK_INSTANCE_TRACKER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+
+#if !defined(__GNUG__)
+#  error "Unsupported platform."
+#endif
+
+#include <boost/config.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <iostream>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+template < typename T, typename CallStack >
+class tracked_instance;
+
+
+/**
+ * Registry of the live instances of a class T deriving from \ref
+ * tracked_instance: how many there are and, by construction stack, who
+ * created them.
+ *
+ * Instances are linked in place (no allocation) into lists spread over
+ * shards by address, each on its own cache lines with its own lock.  With
+ * set_sample_every(n), one construction in n, by thread, captures its
+ * stack and is linked in; the others only count.  Not sampled, a
+ * construction costs a decrement of a thread-local counter and an atomic
+ * increment.
+ *
+ * @tparam T               The class tracked.
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename T, typename CallStack >
+class instance_tracker
+{
+public:
+
+    typedef T                                tracked_type;
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+
+    /**
+     * Capture the construction stack of one instance in every, by thread.
+     * Applies to the instances constructed from now on.
+     */
+    static void set_sample_every(boost::uint32_t every)
+    {
+        state().every = every ? every : 1;
+    }
+
+    static boost::uint32_t sample_every()
+    {
+        return state().every.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * @return the number of live instances, exactly.
+     */
+    static boost::int64_t live()
+    {
+        boost::int64_t ret = 0;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            ret += state().shards[i].live.load(boost::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    /**
+     * @return the live instances by construction stack: count is the
+     * number of instances, weight their size in bytes, both scaled by the
+     * sampling when they were constructed.
+     */
+    static profile_type live_profile()
+    {
+        state_type& st = state();
+        typedef boost::unordered_map< stack_id_type, sample_value >  by_stack_type;
+        by_stack_type by_stack;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            for (const instance_type* it = st.shards[i].head; it; it = it->_next)
+            {
+                by_stack[it->_stack_id] += sample_value(it->_weight, it->_weight * sizeof(T));
+            }
+        }
+
+        profile_type ret;
+        for (typename by_stack_type::const_iterator it = by_stack.begin(); it != by_stack.end(); ++it)
+        {
+            ret.add(st.depot.get(it->first), it->second);
+        }
+        return ret;
+    }
+
+    /**
+     * Write the live instances, by construction stack, most first: at most
+     * max_stacks stacks.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void report(std::ostream& os, std::size_t max_stacks = 20)
+    {
+        const profile_type profile = live_profile();
+        os << "Live: " << std::dec << live() << " instances, " << profile.total().count
+           << " estimated from " << profile.size() << " stacks\n";
+
+        const std::vector<typename profile_type::entry_type> sorted = profile.sorted();
+        symbol_cache< AddrResolver > cache;
+        for (std::size_t i = 0; i < sorted.size() && i < max_stacks; ++i)
+        {
+            os << "\n" << sorted[i].second.count << " instances (" << sorted[i].second.weight << " bytes) constructed from:\n";
+            for (typename stack_type::const_iterator frm = sorted[i].first.begin(); frm != sorted[i].first.end(); ++frm)
+            {
+                OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+        }
+        os << std::flush;
+    }
+
+private:
+
+    friend class tracked_instance< T, CallStack >;
+    typedef tracked_instance< T, CallStack >  instance_type;
+
+    static const std::size_t shard_bits  = 5;
+    static const std::size_t shard_count = 1 << shard_bits;
+
+    struct BOOST_ALIGNMENT(64) shard_type
+    {
+        boost::mutex                    mutex;
+        instance_type*                  head;    ///< sampled instances
+        boost::atomic<boost::int64_t>   live;    ///< all instances
+
+        shard_type() : head(nullptr), live(0) {}
+    };
+
+    struct state_type
+    {
+        boost::atomic<boost::uint32_t>  every;
+        depot_type                      depot;
+        shard_type                      shards[shard_count];
+
+        state_type() : every(1) {}
+    };
+
+    /*
+     * Never destroyed: instances can outlive the statics.
+     */
+    static state_type& state()
+    {
+        static state_type* st = new state_type();
+        return *st;
+    }
+
+    static shard_type& _shard(const instance_type* obj)
+    {
+        const std::size_t addr = reinterpret_cast<std::size_t>(obj);
+        return state().shards[((addr >> 6) ^ (addr >> (6 + shard_bits))) & (shard_count - 1)];
+    }
+
+    static void _construct(instance_type* obj)
+    {
+        static __thread boost::int32_t countdown = 0;
+
+        state_type& st = state();
+        shard_type& shard = _shard(obj);
+        ++shard.live;
+        if (__builtin_expect(--countdown > 0, 1))
+        {
+            return;
+        }
+        const boost::uint32_t every = st.every.load(boost::memory_order_relaxed);
+        countdown = static_cast<boost::int32_t>(every);
+
+        obj->_stack_id = st.depot.capture();
+        obj->_weight   = every;
+        boost::mutex::scoped_lock lock(shard.mutex);
+        obj->_prev = nullptr;
+        obj->_next = shard.head;
+        if (shard.head)
+        {
+            shard.head->_prev = obj;
+        }
+        shard.head = obj;
+    }
+
+    static void _destroy(instance_type* obj)
+    {
+        shard_type& shard = _shard(obj);
+        --shard.live;
+        if (!obj->_weight)
+        {
+            return;
+        }
+        boost::mutex::scoped_lock lock(shard.mutex);
+        if (obj->_prev)
+        {
+            obj->_prev->_next = obj->_next;
+        }
+        else
+        {
+            shard.head = obj->_next;
+        }
+        if (obj->_next)
+        {
+            obj->_next->_prev = obj->_prev;
+        }
+    }
+}; //instance_tracker
+
+
+/**
+ * Mixin tracking the live instances of T in \ref instance_tracker, with the
+ * stacks that constructed them:
+ *
+ * @code
+ * class session : public boost::call_stack::tracked_instance<session>
+ * @endcode
+ *
+ * Copies are new instances, constructed where copied; assignment changes
+ * nothing.  Adds 24 bytes to T.
+ *
+ * @tparam T               The class deriving from it.
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename T, typename CallStack = default_stack >
+class tracked_instance
+{
+public:
+
+    typedef instance_tracker< T, CallStack >  tracker_type;
+
+protected:
+
+    tracked_instance()
+        : _prev(nullptr), _next(nullptr), _stack_id(0), _weight(0)
+    {
+        tracker_type::_construct(this);
+    }
+
+    tracked_instance(const tracked_instance&)
+        : _prev(nullptr), _next(nullptr), _stack_id(0), _weight(0)
+    {
+        tracker_type::_construct(this);
+    }
+
+    tracked_instance& operator=(const tracked_instance&)
+    {
+        return *this;
+    }
+
+    ~tracked_instance()
+    {
+        tracker_type::_destroy(this);
+    }
+
+private:
+
+    friend class instance_tracker< T, CallStack >;
+
+    tracked_instance*                         _prev;
+    tracked_instance*                         _next;
+    typename tracker_type::stack_id_type      _stack_id;
+    boost::uint32_t                           _weight;    ///< 0: not sampled
+}; //tracked_instance
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_INSTANCE_TRACKER_HPP)
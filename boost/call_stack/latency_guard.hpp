@@ -0,0 +1,101 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_LATENCY_GUARD_HPP)
+#define BOOST_CALL_STACK_LATENCY_GUARD_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Captures the call stack when a scope takes too long: the time is taken
+ * at construction and at destruction, and only when it exceeds the
+ * threshold is the stack captured and added to the sink, with the time
+ * elapsed as weight.  Below the threshold, the guard costs two reads of the
+ * monotonic clock.
+ *
+ * The sink is a \ref stack_histogram, a \ref stack_profile or anything with
+ * a stack_type and add(stack, count, weight); thread-safe if the scope
+ * runs in several threads.  GCC on Linux only.
+ *
+ * @tparam Sink            See above.
+ */
+template < typename Sink >
+class latency_guard : private boost::noncopyable
+{
+public:
+
+    typedef Sink                          sink_type;
+    typedef typename Sink::stack_type     stack_type;
+
+    /**
+     * @param threshold_ns Scopes lasting at least this long are captured.
+     */
+    latency_guard(sink_type& sink, boost::uint64_t threshold_ns)
+        : _sink(sink)
+        , _threshold_ns(threshold_ns)
+        , _start_ns(detail::monotonic_ns())
+    {}
+
+    ~latency_guard()
+    {
+        const boost::uint64_t elapsed = detail::monotonic_ns() - _start_ns;
+        if (elapsed >= _threshold_ns)
+        {
+            stack_type stack;
+            stack.get_stack();
+            _sink.add(stack, 1, elapsed);
+        }
+    }
+
+    /**
+     * @return the time elapsed since construction.
+     */
+    boost::uint64_t elapsed_ns() const
+    {
+        return detail::monotonic_ns() - _start_ns;
+    }
+
+private:
+
+    sink_type&             _sink;
+    const boost::uint64_t  _threshold_ns;
+    const boost::uint64_t  _start_ns;
+}; //latency_guard
+
+
+}} //namespace boost::call_stack
+
+
+/**
+ * Capture the call stack into sink, a \ref stack_histogram or like, at the
+ * end of the enclosing scope if it lasted at least threshold_ns.
+ */
+#define BOOST_CALL_STACK_LATENCY_GUARD(sink, threshold_ns)                                  \
+    boost::call_stack::latency_guard< __typeof__(sink) >                                   \
+        BOOST_PP_CAT(boost_call_stack_latency_guard_, __LINE__)((sink), (threshold_ns))
+
+
+#endif //#if !defined(BOOST_CALL_STACK_LATENCY_GUARD_HPP)
@@ -0,0 +1,353 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_LEAK_CHECKER_HPP)
+#define BOOST_CALL_STACK_LEAK_CHECKER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/malloc_hooks.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Leak checker: records the call stack of each live heap allocation and
+ * reports live memory grouped by allocation stack.
+ *
+ * Allocations are seen through the malloc() & co. and operator new/delete
+ * defined by the library: define BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS
+ * before including this header in exactly one translation unit of the
+ * program.  Without them, start() fails.
+ *
+ * Allocations are tracked between start() and stop(); a block allocated
+ * before start() is never reported.  Each tracked allocation costs one
+ * stack capture, a \ref stack_depot lookup and an insertion in a table
+ * spread over independently locked shards.  The memory used by the checker
+ * itself is not tracked.
+ *
+ * GCC on Linux (glibc) only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_leak_checker
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+
+    /**
+     * Start tracking allocations.
+     * @return false if the malloc hooks are not in the program.
+     */
+    static bool start()
+    {
+        if (!detail::malloc_hooks::defined())
+        {
+            return false;
+        }
+        state();  // Construct it now rather than in a hook
+        if (!_registered().exchange(true))
+        {
+            // Frees are always observed: a block stays tracked until freed
+            if (!detail::malloc_hooks::add(&basic_leak_checker::_on_alloc, &basic_leak_checker::_on_free))
+            {
+                _registered() = false;
+                return false;
+            }
+        }
+        _started() = true;
+        return true;
+    }
+
+    /**
+     * Stop tracking new allocations.  Blocks tracked so far stay tracked
+     * until freed, or \ref clear().
+     */
+    static void stop()
+    {
+        _started() = false;
+    }
+
+    static bool running()
+    {
+        return _started().load();
+    }
+
+    /**
+     * @return the live allocations grouped by stack: count is the number
+     * of blocks, weight their size in bytes.
+     */
+    static profile_type live_profile()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        state_type& st = state();
+
+        boost::unordered_map< stack_id_type, sample_value > by_id;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            const blocks_type& blocks = st.shards[i].blocks;
+            for (typename blocks_type::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+            {
+                by_id[it->second.stack_id] += sample_value(1, it->second.size);
+            }
+        }
+
+        profile_type ret;
+        for (typename boost::unordered_map< stack_id_type, sample_value >::const_iterator it = by_id.begin();
+             it != by_id.end();
+             ++it)
+        {
+            ret.add(st.depot.get(it->first), it->second);
+        }
+        return ret;
+    }
+
+    /**
+     * @return the number of live blocks tracked and their size in bytes.
+     */
+    static sample_value live()
+    {
+        state_type& st = state();
+        sample_value ret;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            ret.count  += st.shards[i].blocks.size();
+            ret.weight += st.shards[i].bytes;
+        }
+        return ret;
+    }
+
+    /**
+     * Forget the blocks tracked so far.
+     */
+    static void clear()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        state_type& st = state();
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(st.shards[i].mutex);
+            st.shards[i].blocks.clear();
+            st.shards[i].bytes = 0;
+        }
+    }
+
+    /**
+     * Write the live allocations, largest first: at most max_stacks stacks.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void report(std::ostream& os, std::size_t max_stacks = 20)
+    {
+        detail::malloc_hooks::scoped_guard guard;
+
+        const profile_type profile = live_profile();
+        const sample_value total   = profile.total();
+        os << "Live: " << std::dec << total.weight << " bytes in " << total.count
+           << " blocks from " << profile.size() << " stacks\n";
+
+        const std::vector<typename profile_type::entry_type> sorted = profile.sorted(true);
+        symbol_cache< AddrResolver > cache;
+        for (std::size_t i = 0; i < sorted.size() && i < max_stacks; ++i)
+        {
+            os << "\n" << sorted[i].second.weight << " bytes in " << sorted[i].second.count << " blocks allocated from:\n";
+            for (typename stack_type::const_iterator frm = sorted[i].first.begin(); frm != sorted[i].first.end(); ++frm)
+            {
+                OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+        }
+        os << std::flush;
+    }
+
+    /**
+     * Write the live allocations to stderr at exit, as leaks.  Call it
+     * early (e.g. first thing in main()): statics destroyed before the
+     * report are not reported.
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void report_at_exit(std::size_t max_stacks = 20)
+    {
+        _report_max() = max_stacks;
+        _report_fn()  = &basic_leak_checker::_report_stderr< AddrResolver, OutputFormatter >;
+        if (!_report_registered().exchange(true))
+        {
+            std::atexit(&basic_leak_checker::_at_exit);
+        }
+    }
+
+private:
+
+    static const std::size_t shard_bits  = 6;
+    static const std::size_t shard_count = 1 << shard_bits;
+
+    struct block_type
+    {
+        std::size_t    size;
+        stack_id_type  stack_id;
+    };
+
+    typedef boost::unordered_map< void*, block_type >  blocks_type;
+
+    struct shard_type
+    {
+        boost::mutex   mutex;
+        blocks_type    blocks;
+        std::size_t    bytes;
+
+        shard_type() : bytes(0) {}
+    };
+
+    struct state_type
+    {
+        depot_type   depot;
+        shard_type   shards[shard_count];
+    };
+
+    typedef void (*report_fn)(std::size_t);
+
+    /*
+     * Never destroyed: frees happen until the very end of the process.
+     */
+    static state_type& state()
+    {
+        static state_type* st = _create();
+        return *st;
+    }
+
+    static state_type* _create()
+    {
+        detail::malloc_hooks::scoped_guard guard;
+        static typename boost::aligned_storage< sizeof(state_type)
+                                              , boost::alignment_of<state_type>::value >::type storage;
+        return new (&storage) state_type();
+    }
+
+    static shard_type& _shard(void* ptr)
+    {
+        // Blocks are at least 16-byte aligned
+        return state().shards[(reinterpret_cast<std::size_t>(ptr) >> 4) & (shard_count - 1)];
+    }
+
+    static void _on_alloc(void* ptr, std::size_t size)
+    {
+        if (!_started().load(boost::memory_order_relaxed))
+        {
+            return;
+        }
+        stack_type stack;
+        stack.get_stack();
+        block_type block;
+        block.size     = size;
+        block.stack_id = state().depot.intern(stack);
+
+        shard_type& shard = _shard(ptr);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        shard.blocks[ptr] = block;
+        shard.bytes += size;
+    }
+
+    static void _on_free(void* ptr)
+    {
+        shard_type& shard = _shard(ptr);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename blocks_type::iterator it = shard.blocks.find(ptr);
+        if (it != shard.blocks.end())
+        {
+            shard.bytes -= it->second.size;
+            shard.blocks.erase(it);
+        }
+    }
+
+    static boost::atomic<bool>& _started()
+    {
+        static boost::atomic<bool> started(false);
+        return started;
+    }
+
+    static boost::atomic<bool>& _registered()
+    {
+        static boost::atomic<bool> registered(false);
+        return registered;
+    }
+
+    static boost::atomic<bool>& _report_registered()
+    {
+        static boost::atomic<bool> registered(false);
+        return registered;
+    }
+
+    static report_fn& _report_fn()
+    {
+        static report_fn fn = nullptr;
+        return fn;
+    }
+
+    static std::size_t& _report_max()
+    {
+        static std::size_t max = 0;
+        return max;
+    }
+
+    template < typename AddrResolver, typename OutputFormatter >
+    static void _report_stderr(std::size_t max_stacks)
+    {
+        report< AddrResolver, OutputFormatter >(std::cerr, max_stacks);
+    }
+
+    static void _at_exit()
+    {
+        stop();
+        if (_report_fn())
+        {
+            std::cerr << "*** Leak check: ";
+            _report_fn()(_report_max());
+        }
+    }
+}; //basic_leak_checker
+
+
+typedef basic_leak_checker< default_stack >  default_leak_checker;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_LEAK_CHECKER_HPP)
@@ -0,0 +1,494 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_LOCK_ORDER_HPP)
+#define BOOST_CALL_STACK_LOCK_ORDER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Lock order checker: finds the locks acquired in inconsistent orders, the
+ * potential deadlocks, even when they did not deadlock.
+ *
+ * Each \ref basic_checked_mutex "checked mutex" has an id.  Acquiring B
+ * while holding A adds the edge A -> B to a graph of lock orders, with the
+ * stack of that first acquisition, interned in a \ref stack_depot.  A new
+ * edge closing a cycle (B was acquired, maybe indirectly, while holding A)
+ * is a violation: it is reported with the stacks of all the edges in the
+ * cycle.  Each edge is checked once: known edges are found in a per-thread
+ * cache, and only new ones take the lock of the graph.  try_lock() cannot
+ * deadlock and adds no edges.
+ *
+ * The graph keeps the locks destroyed: ids are not reused.  GCC on Linux
+ * only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_lock_order_checker
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+    typedef boost::uint32_t                  lock_id_type;
+
+    /**
+     * Lock to was acquired while holding lock from.
+     */
+    struct edge_type
+    {
+        lock_id_type            from;
+        lock_id_type            to;
+        stack_id_type           stack_id;   ///< of the first such acquisition
+        detail::thread_id_type  tid;
+    };
+
+    /**
+     * A cycle of lock orders: the new edge first, then the path back from
+     * its lock to its held lock.
+     */
+    struct violation_type
+    {
+        std::vector<edge_type>  cycle;
+    };
+
+    typedef void (*handler_type)(const violation_type&);
+
+    struct stats_type
+    {
+        boost::uint64_t  acquisitions;
+        boost::uint64_t  edges;
+        boost::uint64_t  violations;
+    };
+
+    /**
+     * Max locks held at once by a thread; deeper ones are not checked.
+     */
+    static const std::size_t max_held = 32;
+
+    static void start()
+    {
+        state().started = true;
+    }
+
+    static void stop()
+    {
+        state().started = false;
+    }
+
+    static bool running()
+    {
+        return state().started.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * Set the function called for each violation, by the thread that found
+     * it, before it blocks on the lock.
+     */
+    static void on_violation(handler_type handler)
+    {
+        state().handler = handler;
+    }
+
+    /**
+     * @return the violations found since start() or clear().
+     */
+    static std::vector<violation_type> violations()
+    {
+        state_type& st = state();
+        boost::mutex::scoped_lock lock(st.mutex);
+        return st.violations;
+    }
+
+    static stats_type stats()
+    {
+        const state_type& st = state();
+        stats_type ret;
+        ret.acquisitions = st.acquisitions.load();
+        ret.edges        = st.edge_count.load();
+        ret.violations   = st.violation_count.load();
+        return ret;
+    }
+
+    /**
+     * @return the stack of an edge.
+     */
+    static const stack_type& stack(stack_id_type id)
+    {
+        return state().depot.get(id);
+    }
+
+    /**
+     * Forget the lock orders seen and the violations.
+     */
+    static void clear()
+    {
+        state_type& st = state();
+        boost::mutex::scoped_lock lock(st.mutex);
+        st.graph.clear();
+        st.violations.clear();
+        st.acquisitions    = 0;
+        st.edge_count      = 0;
+        st.violation_count = 0;
+        ++st.generation;
+    }
+
+    /**
+     * Write a violation: the edges of the cycle and their stacks.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void write(std::ostream& os, const violation_type& violation)
+    {
+        os << "Lock order inversion: cycle of " << std::dec << violation.cycle.size() << " locks\n";
+        symbol_cache< AddrResolver > cache;
+        for (std::size_t i = 0; i < violation.cycle.size(); ++i)
+        {
+            const edge_type& edge = violation.cycle[i];
+            os << "\nLock #" << edge.to << " acquired while holding lock #" << edge.from
+               << ", thread " << edge.tid << (i ? ":\n" : " (new):\n");
+            const stack_type& stk = stack(edge.stack_id);
+            for (typename stack_type::const_iterator frm = stk.begin(); frm != stk.end(); ++frm)
+            {
+                OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+        }
+        os << std::flush;
+    }
+
+    /*
+     * Called by the mutexes.
+     */
+
+    static lock_id_type new_lock_id()
+    {
+        return ++state().last_lock_id;
+    }
+
+    /**
+     * Before blocking on lock id: check the new edges.
+     */
+    static void on_lock(lock_id_type id)
+    {
+        state_type&  st = state();
+        thread_type& th = _thread();
+        ++st.acquisitions;
+
+        const boost::uint32_t generation = st.generation.load(boost::memory_order_relaxed);
+        if (th.generation != generation)
+        {
+            std::fill(th.cache, th.cache + cache_size, boost::uint64_t(0));
+            th.generation = generation;
+        }
+
+        const std::size_t depth = th.depth < max_held ? th.depth : max_held;
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            const lock_id_type held = th.held[i];
+            if (held == id)
+            {
+                continue;
+            }
+            const boost::uint64_t key = (boost::uint64_t(held) << 32) | id;
+            boost::uint64_t& cached = th.cache[(key * 0x9E3779B97F4A7C15ull) >> (64 - cache_bits)];
+            if (cached != key)
+            {
+                _add_edge(held, id);
+                cached = key;
+            }
+        }
+    }
+
+    /**
+     * Lock id was acquired.
+     */
+    static void on_locked(lock_id_type id)
+    {
+        thread_type& th = _thread();
+        if (th.depth < max_held)
+        {
+            th.held[th.depth] = id;
+        }
+        ++th.depth;
+    }
+
+    static void on_unlock(lock_id_type id)
+    {
+        thread_type& th = _thread();
+        if (!th.depth)
+        {
+            return; // Locked while not running
+        }
+        const std::size_t depth = th.depth < max_held ? th.depth : max_held;
+        for (std::size_t i = depth; i-- > 0; )
+        {
+            if (th.held[i] == id)
+            {
+                std::copy(th.held + i + 1, th.held + depth, th.held + i);
+                --th.depth;
+                return;
+            }
+        }
+        if (th.depth > max_held)
+        {
+            --th.depth;
+        }
+    }
+
+private:
+
+    static const std::size_t cache_bits = 8;
+    static const std::size_t cache_size = 1 << cache_bits;
+
+    /*
+     * Plain data: thread-local.
+     */
+    struct thread_type
+    {
+        lock_id_type     held[max_held];
+        std::size_t      depth;
+        boost::uint32_t  generation;
+        boost::uint64_t  cache[cache_size];   ///< edges known, direct-mapped
+    };
+
+    typedef boost::unordered_map< lock_id_type, std::vector<edge_type> >  graph_type;
+
+    struct state_type
+    {
+        boost::atomic<bool>             started;
+        boost::atomic<lock_id_type>     last_lock_id;
+        boost::atomic<boost::uint32_t>  generation;
+        handler_type                    handler;
+
+        boost::atomic<boost::uint64_t>  acquisitions;
+        boost::atomic<boost::uint64_t>  edge_count;
+        boost::atomic<boost::uint64_t>  violation_count;
+
+        depot_type                      depot;
+        boost::mutex                    mutex;     ///< guards graph and violations
+        graph_type                      graph;     ///< edges by from
+        std::vector<violation_type>     violations;
+
+        state_type()
+            : started(false), last_lock_id(0), generation(1), handler(nullptr)
+            , acquisitions(0), edge_count(0), violation_count(0)
+        {}
+    };
+
+    /*
+     * Never destroyed: mutexes can be used until the very end of the process.
+     */
+    static state_type& state()
+    {
+        static state_type* st = new state_type();
+        return *st;
+    }
+
+    static thread_type& _thread()
+    {
+        static __thread thread_type th;
+        return th;
+    }
+
+    static void _add_edge(lock_id_type from, lock_id_type to)
+    {
+        state_type& st = state();
+        edge_type edge;
+        edge.from     = from;
+        edge.to       = to;
+        edge.stack_id = depot_type::null_id;
+        edge.tid      = detail::current_thread_id();
+
+        violation_type violation;
+        {
+            boost::mutex::scoped_lock lock(st.mutex);
+            std::vector<edge_type>& out = st.graph[from];
+            for (std::size_t i = 0; i < out.size(); ++i)
+            {
+                if (out[i].to == to)
+                {
+                    return; // Seen by another thread
+                }
+            }
+
+            lock.unlock();
+            edge.stack_id = st.depot.capture();
+            lock.lock();
+
+            std::vector<edge_type>& again = st.graph[from];
+            for (std::size_t i = 0; i < again.size(); ++i)
+            {
+                if (again[i].to == to)
+                {
+                    return;
+                }
+            }
+            ++st.edge_count;
+
+            violation.cycle.push_back(edge);
+            const bool cycle = _find_path(st.graph, to, from, violation.cycle);
+            again.push_back(edge);
+            if (!cycle)
+            {
+                return;
+            }
+            ++st.violation_count;
+            st.violations.push_back(violation);
+        }
+
+        if (handler_type handler = st.handler)
+        {
+            handler(violation);
+        }
+    }
+
+    /*
+     * Depth-first search of a path from to target, appended to path.
+     */
+    static bool _find_path(const graph_type& graph, lock_id_type from, lock_id_type target, std::vector<edge_type>& path)
+    {
+        boost::unordered_set<lock_id_type> visited;
+        std::vector< std::pair<lock_id_type, std::size_t> > todo;   // lock, next edge
+        const std::size_t base = path.size();
+
+        todo.push_back(std::make_pair(from, std::size_t(0)));
+        visited.insert(from);
+        while (!todo.empty())
+        {
+            if (todo.back().first == target)
+            {
+                return true;
+            }
+            typename graph_type::const_iterator it = graph.find(todo.back().first);
+            const std::size_t next = todo.back().second++;
+            if (it == graph.end() || next >= it->second.size())
+            {
+                todo.pop_back();
+                if (path.size() > base)
+                {
+                    path.pop_back();
+                }
+                continue;
+            }
+            const edge_type& edge = it->second[next];
+            if (visited.insert(edge.to).second)
+            {
+                path.push_back(edge);
+                todo.push_back(std::make_pair(edge.to, std::size_t(0)));
+            }
+        }
+        return false;
+    }
+}; //basic_lock_order_checker
+
+
+/**
+ * A mutex reporting its acquisitions to \ref basic_lock_order_checker while
+ * it runs; otherwise it costs a flag test per lock() and a look at the
+ * locks held per unlock().  Lockable: use it with boost::lock_guard,
+ * boost::unique_lock, std::lock_guard...
+ *
+ * @tparam Mutex           The mutex wrapped: boost::mutex, std::mutex... with
+ *                         lock(), try_lock() and unlock().
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename Mutex, typename CallStack >
+class basic_checked_mutex : private boost::noncopyable
+{
+public:
+
+    typedef Mutex                                   mutex_type;
+    typedef basic_lock_order_checker< CallStack >   checker_type;
+    typedef typename checker_type::lock_id_type     lock_id_type;
+
+    basic_checked_mutex()
+        : _id(checker_type::new_lock_id())
+    {}
+
+    void lock()
+    {
+        if (!checker_type::running())
+        {
+            _mutex.lock();
+            return;
+        }
+        checker_type::on_lock(_id);
+        _mutex.lock();
+        checker_type::on_locked(_id);
+    }
+
+    bool try_lock()
+    {
+        if (!_mutex.try_lock())
+        {
+            return false;
+        }
+        if (checker_type::running())
+        {
+            checker_type::on_locked(_id);
+        }
+        return true;
+    }
+
+    void unlock()
+    {
+        checker_type::on_unlock(_id);
+        _mutex.unlock();
+    }
+
+    lock_id_type id() const noexcept { return _id; }
+
+    mutex_type&       native()       noexcept { return _mutex; }
+    const mutex_type& native() const noexcept { return _mutex; }
+
+private:
+
+    mutex_type          _mutex;
+    const lock_id_type  _id;
+}; //basic_checked_mutex
+
+
+typedef basic_lock_order_checker< default_stack >           default_lock_order_checker;
+typedef basic_checked_mutex< boost::mutex, default_stack >  default_checked_mutex;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_LOCK_ORDER_HPP)
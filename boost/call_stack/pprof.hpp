@@ -0,0 +1,373 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_PPROF_HPP)
+#define BOOST_CALL_STACK_PPROF_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/detail/protobuf.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/modules.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <time.h>
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Writes call stacks in the format of pprof (github.com/google/pprof): a
+ * gzip-compressed profile.proto message, also read by speedscope and
+ * others.
+ *
+ * Each sample has two values: a count ("samples") and a weight (by default
+ * "cpu" in "nanoseconds").  Samples are compressed and written out as
+ * they are added; locations (one per distinct address), functions,
+ * mappings (the executable segments of the binaries loaded) and strings
+ * are kept, deduplicated, and written by \ref finish().  Each distinct
+ * address is resolved once.
+ *
+ * Define BOOST_CALL_STACK_NO_ZLIB to write uncompressed profiles, which
+ * pprof reads too.  GCC on Linux only.
+ *
+ * @tparam AddrResolver    See \ref symbol_resolver; extended_symbol_resolver
+ *                         gives source files and lines.
+ */
+template < typename AddrResolver >
+class pprof_writer : private boost::noncopyable
+{
+public:
+
+    typedef AddrResolver  symbol_resolver_type;
+    typedef std::size_t   size_type;
+
+    /**
+     * @param os           Binary stream written to.
+     * @param weight_type  What the weight of the samples measures.
+     * @param weight_unit  Its unit.
+     * @param period       Sampling period in weight units, 0 if unknown.
+     */
+    explicit pprof_writer(std::ostream& os,
+                          const std::string& weight_type = "cpu",
+                          const std::string& weight_unit = "nanoseconds",
+                          boost::uint64_t period = 0)
+        : _sink(os)
+        , _start_ns(_now())
+        , _period(period)
+        , _finished(false)
+        , _modules(detail::list_modules())
+    {
+        _string("");  // Index 0 is the empty string
+
+        _count_type.add(1, _string("samples")).add(2, _string("count"));
+        _weight_type.add(1, _string(weight_type)).add(2, _string(weight_unit));
+
+        _msg.clear();
+        _msg.add(profile_sample_type, _count_type);
+        _msg.add(profile_sample_type, _weight_type);
+        _sink.write(_msg.str());
+    }
+
+    ~pprof_writer()
+    {
+        finish();
+    }
+
+    /**
+     * Write one sample.  Empty stacks are skipped.
+     */
+    template < typename CallStack >
+    void add(const CallStack& stack, boost::uint64_t count, boost::uint64_t weight)
+    {
+        if (_finished || stack.empty())
+        {
+            return;
+        }
+
+        _ids.clear();
+        for (typename CallStack::const_iterator frm = stack.begin(); frm != stack.end(); ++frm)
+        {
+            _ids.push_back(_location(frm->addr()));
+        }
+        _values.clear();
+        _values.push_back(count);
+        _values.push_back(weight);
+
+        _sample.clear();
+        _sample.add_packed(1, _ids).add_packed(2, _values);
+        _msg.clear();
+        _msg.add(profile_sample, _sample);
+        _sink.write(_msg.str());
+    }
+
+    /**
+     * Write all the samples of a profile.
+     */
+    template < typename CallStack >
+    void add(const stack_profile<CallStack>& profile)
+    {
+        typedef typename stack_profile<CallStack>::const_iterator  const_iterator;
+        for (const_iterator it = profile.begin(); it != profile.end(); ++it)
+        {
+            add(it->first, it->second.count, it->second.weight);
+        }
+    }
+
+    /**
+     * Write the tables and close the stream.  Samples added afterwards are
+     * ignored.
+     */
+    void finish()
+    {
+        if (_finished)
+        {
+            return;
+        }
+        _finished = true;
+
+        for (std::size_t i = 0; i < _mapping_used.size(); ++i)
+        {
+            if (!_mapping_used[i])
+                continue;
+            const detail::module_info& mod = _modules[i];
+            proto_type mapping;
+            mapping.add(1, i + 1)
+                   .add(2, mod.start)
+                   .add(3, mod.limit)
+                   .add(4, mod.offset)
+                   .add(5, _string(mod.name))
+                   .add(7, 1);  // has_functions
+            _msg.clear();
+            _msg.add(profile_mapping, mapping);
+            _sink.write(_msg.str());
+        }
+
+        for (std::size_t i = 0; i < _locations.size(); ++i)
+        {
+            const location_type& loc = _locations[i];
+            proto_type location;
+            location.add(1, i + 1)
+                    .add(2, loc.mapping_id)
+                    .add(3, loc.address);
+            if (loc.function_id)
+            {
+                proto_type line;
+                line.add(1, loc.function_id).add_signed(2, loc.line);
+                location.add(4, line);
+            }
+            _msg.clear();
+            _msg.add(profile_location, location);
+            _sink.write(_msg.str());
+        }
+
+        for (std::size_t i = 0; i < _functions.size(); ++i)
+        {
+            proto_type function;
+            function.add(1, i + 1)
+                    .add(2, _functions[i].first)
+                    .add(3, _functions[i].first)
+                    .add(4, _functions[i].second);
+            _msg.clear();
+            _msg.add(profile_function, function);
+            _sink.write(_msg.str());
+        }
+
+        // The strings last: nothing adds any afterwards
+        const boost::uint64_t end_ns = _now();
+        _msg.clear();
+        _msg.add(profile_time_nanos, _start_ns)
+            .add(profile_duration_nanos, end_ns - _start_ns)
+            .add(profile_period_type, _weight_type)
+            .add(profile_period, _period);
+        for (std::size_t i = 0; i < _strings.size(); ++i)
+        {
+            _msg.add(profile_string_table, *_strings[i]);
+        }
+        _sink.write(_msg.str());
+        _sink.finish();
+    }
+
+    /**
+     * @return the number of distinct addresses written so far.
+     */
+    size_type locations() const noexcept { return _locations.size(); }
+
+private:
+
+    typedef detail::proto_message  proto_type;
+
+    enum profile_field
+    {
+        profile_sample_type    = 1,
+        profile_sample         = 2,
+        profile_mapping        = 3,
+        profile_location       = 4,
+        profile_function       = 5,
+        profile_string_table   = 6,
+        profile_time_nanos     = 9,
+        profile_duration_nanos = 10,
+        profile_period_type    = 11,
+        profile_period         = 12
+    };
+
+    struct location_type
+    {
+        boost::uint64_t  address;
+        boost::uint64_t  mapping_id;
+        boost::uint64_t  function_id;
+        boost::int64_t   line;
+    };
+
+    typedef boost::unordered_map< std::string, boost::uint64_t >  strings_type;
+    typedef std::pair< boost::uint64_t, boost::uint64_t >         function_key;   ///< name, file
+    typedef boost::unordered_map< function_key
+                                , boost::uint64_t
+                                , boost::hash<function_key> >     functions_type;
+    typedef boost::unordered_map< address_type
+                                , boost::uint64_t
+                                , boost::hash<address_type> >     addresses_type;
+
+    static boost::uint64_t _now()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<boost::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<boost::uint64_t>(ts.tv_nsec);
+    }
+
+    boost::uint64_t _string(const std::string& str)
+    {
+        strings_type::iterator it = _string_ids.find(str);
+        if (it == _string_ids.end())
+        {
+            it = _string_ids.insert(strings_type::value_type(str, _strings.size())).first;
+            _strings.push_back(&it->first);  // Node-based: stable
+        }
+        return it->second;
+    }
+
+    boost::uint64_t _location(const address_type& addr)
+    {
+        typename addresses_type::iterator it = _addresses.find(addr);
+        if (it != _addresses.end())
+        {
+            return it->second;
+        }
+
+        // Resolvers re-resolve when copied: resolve in place.
+        symbol_resolver_type sym;
+        sym.resolve(addr);
+
+        location_type loc;
+        loc.address    = reinterpret_cast<std::size_t>(addr);
+        loc.mapping_id = _mapping(loc.address);
+        loc.line       = sym.line_number();
+
+        loc.function_id = 0;
+        std::string name(sym.demangled_name());
+        if (name != "??")
+        {
+            std::string file(sym.source_file());
+            function_key key(_string(name), _string(file == "??" ? std::string() : file));
+            typename functions_type::iterator fit = _function_ids.find(key);
+            if (fit == _function_ids.end())
+            {
+                _functions.push_back(key);
+                fit = _function_ids.insert(typename functions_type::value_type(key, _functions.size())).first;
+            }
+            loc.function_id = fit->second;
+        }
+
+        _locations.push_back(loc);
+        return _addresses.insert(typename addresses_type::value_type(addr, _locations.size())).first->second;
+    }
+
+    boost::uint64_t _mapping(std::size_t address)
+    {
+        std::vector<detail::module_info>::const_iterator mod = _modules.begin();
+        for (; mod != _modules.end(); ++mod)
+        {
+            if (address >= mod->start && address < mod->limit)
+            {
+                std::size_t idx = static_cast<std::size_t>(mod - _modules.begin());
+                if (_mapping_used.size() <= idx)
+                {
+                    _mapping_used.resize(_modules.size(), false);
+                }
+                _mapping_used[idx] = true;
+                return idx + 1;
+            }
+        }
+        return 0;
+    }
+
+private:
+
+    detail::gzip_sink                   _sink;
+    const boost::uint64_t               _start_ns;
+    const boost::uint64_t               _period;
+    bool                                _finished;
+
+    proto_type                          _count_type;
+    proto_type                          _weight_type;
+    proto_type                          _sample;
+    proto_type                          _msg;
+    std::vector<boost::uint64_t>        _ids;
+    std::vector<boost::uint64_t>        _values;
+
+    strings_type                        _string_ids;
+    std::vector<const std::string*>     _strings;
+    functions_type                      _function_ids;
+    std::vector<function_key>           _functions;
+    addresses_type                      _addresses;
+    std::vector<location_type>          _locations;
+    std::vector<detail::module_info>    _modules;
+    std::vector<bool>                   _mapping_used;
+}; //pprof_writer
+
+
+/**
+ * Write a profile in pprof format, see \ref pprof_writer.
+ */
+template < typename AddrResolver, typename CallStack > inline
+void write_pprof(std::ostream& os, const stack_profile<CallStack>& profile,
+                 const std::string& weight_type = "cpu",
+                 const std::string& weight_unit = "nanoseconds",
+                 boost::uint64_t period = 0)
+{
+    pprof_writer< AddrResolver > writer(os, weight_type, weight_unit, period);
+    writer.add(profile);
+    writer.finish();
+}
+
+
+typedef pprof_writer< default_symbol_resolver >  default_pprof_writer;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_PPROF_HPP)
@@ -0,0 +1,179 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_PROFILE_HPP)
+#define BOOST_CALL_STACK_PROFILE_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * What was accumulated for a call stack: how many times it was seen and
+ * a weight (e.g. nanoseconds, bytes).
+ */
+struct sample_value
+{
+    boost::uint64_t  count;
+    boost::uint64_t  weight;
+
+    sample_value(boost::uint64_t c = 0, boost::uint64_t w = 0)
+        : count(c)
+        , weight(w)
+    {}
+
+    sample_value& operator+=(const sample_value& other)
+    {
+        count  += other.count;
+        weight += other.weight;
+        return *this;
+    }
+
+    bool operator==(const sample_value& other) const
+    {
+        return count == other.count && weight == other.weight;
+    }
+    bool operator!=(const sample_value& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+
+/**
+ * Call stacks and what was accumulated for each: the common currency of
+ * the profilers and of the exporters of this library.  Not thread-safe.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class stack_profile
+{
+public:
+
+    typedef CallStack                                        stack_type;
+    typedef boost::unordered_map< stack_type
+                                , sample_value
+                                , boost::hash<stack_type> >  map_type;
+    typedef typename map_type::value_type                    value_type;
+    typedef std::pair< stack_type, sample_value >            entry_type;   ///< copyable value_type
+    typedef typename map_type::size_type                     size_type;
+    typedef typename map_type::const_iterator                const_iterator;
+
+    stack_profile() {}
+
+    void add(const stack_type& stack, boost::uint64_t count = 1, boost::uint64_t weight = 0)
+    {
+        _stacks[stack] += sample_value(count, weight);
+    }
+
+    void add(const stack_type& stack, const sample_value& value)
+    {
+        _stacks[stack] += value;
+    }
+
+    void merge(const stack_profile& other)
+    {
+        for (const_iterator it = other.begin(); it != other.end(); ++it)
+        {
+            _stacks[it->first] += it->second;
+        }
+    }
+
+    /**
+     * @return the value accumulated for stack, zero if not seen.
+     */
+    sample_value value(const stack_type& stack) const
+    {
+        const_iterator it = _stacks.find(stack);
+        return it != _stacks.end() ? it->second : sample_value();
+    }
+
+    /**
+     * @return the sum of the values of all the stacks.
+     */
+    sample_value total() const
+    {
+        sample_value sum;
+        for (const_iterator it = begin(); it != end(); ++it)
+        {
+            sum += it->second;
+        }
+        return sum;
+    }
+
+    /**
+     * @return the stacks sorted by decreasing count, or weight.
+     */
+    std::vector<entry_type> sorted(bool by_weight = false) const
+    {
+        std::vector<entry_type> ret(begin(), end());
+        std::sort(ret.begin(), ret.end(), by_weight ? &stack_profile::_by_weight : &stack_profile::_by_count);
+        return ret;
+    }
+
+    size_type size()  const noexcept { return _stacks.size(); }
+    bool      empty() const noexcept { return _stacks.empty(); }
+
+    const_iterator begin()  const { return _stacks.begin(); }
+    const_iterator end()    const { return _stacks.end(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend()   const { return end(); }
+
+    void clear()
+    {
+        _stacks.clear();
+    }
+
+    void swap(stack_profile& other) noexcept
+    {
+        _stacks.swap(other._stacks);
+    }
+
+private:
+
+    static bool _by_count(const entry_type& left, const entry_type& right)
+    {
+        return left.second.count > right.second.count;
+    }
+
+    static bool _by_weight(const entry_type& left, const entry_type& right)
+    {
+        return left.second.weight > right.second.weight;
+    }
+
+private:
+
+    map_type  _stacks;
+}; //stack_profile
+
+template < typename CallStack > inline
+void swap(stack_profile<CallStack>& left, stack_profile<CallStack>& right) noexcept
+{
+    left.swap(right);
+}
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_PROFILE_HPP)
@@ -0,0 +1,458 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_PROFILER_HPP)
+#define BOOST_CALL_STACK_PROFILER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/sampler.hpp>
+#  include <boost/call_stack/detail/gnu/perf.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Sampling profiler: the machinery shared by \ref cpu_profiler,
+ * \ref wall_profiler and \ref perf_profiler.
+ *
+ * Each thread of the process gets a sampler which fills a ring of its own
+ * with call stacks: by default a timer (timer_create(2)) delivering a
+ * signal to that thread, whose handler captures the interrupted call stack.
+ * A background thread drains the rings into 
+ * \ref stack_profile "stack_profiles" and picks up threads started (or
+ * gone) since the last look.  Samples are dropped (and counted) if a ring
+ * fills up before it is drained.
+ *
+ * Threads blocking the signal are not sampled.  GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ * @tparam Sampler         detail::thread_sampler or detail::perf_sampler
+ */
+
+template < typename CallStack
+         , typename Sampler = detail::thread_sampler< CallStack >
+         >
+class basic_profiler : private boost::noncopyable
+{
+public:
+
+    typedef CallStack                       stack_type;
+    typedef stack_profile< stack_type >     profile_type;
+
+    /**
+     * @param clk      What drives the timers.
+     * @param hz       Samples per second, per thread.
+     * @param signo    Signal delivered by the timers.
+     * @param flush_ms How often the background thread drains the rings.
+     */
+    basic_profiler(detail::sampling_clock clk,
+                   unsigned int hz,
+                   int signo,
+                   unsigned int flush_ms)
+        : _clock(clk)
+        , _hz(hz ? hz : 1)
+        , _signo(signo)
+        , _flush_ms(flush_ms ? flush_ms : 1)
+        , _running(false)
+        , _stop(false)
+        , _samples(0)
+        , _dropped(0)
+        , _self(0)
+    {}
+
+    ~basic_profiler()
+    {
+        stop();
+    }
+
+    /**
+     * Start sampling all the threads of the process.
+     * @return true if successful, false if the signal has a handler other
+     * than the library's.
+     */
+    bool start()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_running)
+        {
+            return true;
+        }
+        if (!sampler_type::install(_signo))
+        {
+            return false;
+        }
+
+        _stop = false;
+        _self = 0;
+        _thread = boost::thread(&basic_profiler::_run, this);
+        while (!_self)
+        {
+            _started.wait(lock);
+        }
+        _rescan();
+        _running = true;
+        if (_rings.empty())
+        {
+            // Not even the calling thread: the sampler cannot work here
+            lock.unlock();
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Stop sampling.  The samples collected so far are kept.
+     */
+    void stop()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            if (!_running)
+            {
+                return;
+            }
+            _stop = true;
+            _wakeup.notify_all();
+        }
+        _thread.join();
+
+        boost::mutex::scoped_lock lock(_mutex);
+        for (typename rings_type::iterator it = _rings.begin(); it != _rings.end(); ++it)
+        {
+            sampler_type::disarm(*it->second);
+        }
+        _drain();
+        for (typename rings_type::iterator it = _rings.begin(); it != _rings.end(); ++it)
+        {
+            sampler_type::release(it->second);
+        }
+        _rings.clear();
+        sampler_type::uninstall(_signo);
+        _running = false;
+    }
+
+    bool running() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _running;
+    }
+
+    unsigned int frequency() const noexcept { return _hz; }
+
+    /**
+     * @return the on-CPU samples collected so far.
+     */
+    profile_type profile()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _drain();
+        return _profile;
+    }
+
+    /**
+     * @return the on-CPU samples collected so far and start anew.
+     */
+    profile_type take_profile()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _drain();
+        profile_type ret;
+        ret.swap(_profile);
+        return ret;
+    }
+
+    /**
+     * @return the off-CPU samples collected so far; always empty for a
+     * \ref cpu_profiler.
+     */
+    profile_type off_cpu_profile()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _drain();
+        return _off_cpu_profile;
+    }
+
+    /**
+     * @return the off-CPU samples collected so far and start anew.
+     */
+    profile_type take_off_cpu_profile()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _drain();
+        profile_type ret;
+        ret.swap(_off_cpu_profile);
+        return ret;
+    }
+
+    boost::uint64_t samples() const noexcept { return _samples.load(); }
+    boost::uint64_t dropped() const noexcept { return _dropped.load(); }
+
+private:
+
+    typedef Sampler                                            sampler_type;
+    typedef typename sampler_type::ring_type                   ring_type;
+    typedef typename sampler_type::sample_entry_type           sample_entry_type;
+    typedef std::map< detail::thread_id_type, ring_type* >             rings_type;
+
+    /*
+     * A sample counts where the thread spent most of the time since the
+     * previous sample; the weights are split exactly.
+     */
+    struct collector
+    {
+        profile_type&  on_cpu;
+        profile_type&  off_cpu;
+
+        collector(profile_type& on, profile_type& off) : on_cpu(on), off_cpu(off) {}
+
+        void operator()(const sample_entry_type& sample)
+        {
+            const bool mostly_on = sample.weight >= sample.off_cpu_ns;
+            if (sample.weight || mostly_on)
+            {
+                on_cpu.add(sample.stack, mostly_on ? 1 : 0, sample.weight);
+            }
+            if (sample.off_cpu_ns)
+            {
+                off_cpu.add(sample.stack, mostly_on ? 0 : 1, sample.off_cpu_ns);
+            }
+        }
+    };
+
+    void _run()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _self = detail::current_thread_id();
+        _started.notify_all();
+
+        unsigned int ticks = 0;
+        while (!_stop)
+        {
+            _wakeup.timed_wait(lock, boost::posix_time::milliseconds(_flush_ms));
+            if (_stop)
+                break;
+            _drain();
+            if (++ticks * _flush_ms >= 500)
+            {
+                ticks = 0;
+                _rescan();
+            }
+        }
+    }
+
+    // Under _mutex
+    void _drain()
+    {
+        collector coll(_profile, _off_cpu_profile);
+        for (typename rings_type::iterator it = _rings.begin(); it != _rings.end(); ++it)
+        {
+            _samples += sampler_type::drain(*it->second, coll);
+            _dropped += it->second->dropped.exchange(0);
+        }
+    }
+
+    // Under _mutex: sample new threads, forget gone ones.
+    void _rescan()
+    {
+        std::vector<detail::thread_id_type> tids = detail::list_threads();
+        tids.erase(std::remove(tids.begin(), tids.end(), _self), tids.end());
+
+        for (typename rings_type::iterator it = _rings.begin(); it != _rings.end(); )
+        {
+            if (!std::binary_search(tids.begin(), tids.end(), it->first))
+            {
+                sampler_type::disarm(*it->second);
+                collector coll(_profile, _off_cpu_profile);
+                _samples += sampler_type::drain(*it->second, coll);
+                sampler_type::release(it->second);
+                _rings.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        const boost::uint64_t period_ns = 1000000000ull / _hz;
+        for (std::vector<detail::thread_id_type>::const_iterator tid = tids.begin(); tid != tids.end(); ++tid)
+        {
+            if (_rings.count(*tid))
+                continue;
+            ring_type* ring = sampler_type::acquire();
+            if (sampler_type::arm(*ring, *tid, _clock, _signo, period_ns))
+            {
+                _rings[*tid] = ring;
+            }
+            else
+            {
+                sampler_type::release(ring); // Thread is gone, or sampler unavailable
+            }
+        }
+    }
+
+private:
+
+    const detail::sampling_clock  _clock;
+    const unsigned int            _hz;
+    const int                     _signo;
+    const unsigned int            _flush_ms;
+
+    mutable boost::mutex          _mutex;
+    boost::condition_variable     _wakeup;
+    boost::condition_variable     _started;
+    boost::thread                 _thread;
+    bool                          _running;
+    bool                          _stop;
+
+    boost::atomic<boost::uint64_t> _samples;
+    boost::atomic<boost::uint64_t> _dropped;
+
+    detail::thread_id_type        _self;    ///< the background thread
+    rings_type                    _rings;
+    profile_type                  _profile;
+    profile_type                  _off_cpu_profile;
+}; //basic_profiler
+
+
+/**
+ * Sampling CPU profiler: where the threads spend CPU time.
+ *
+ * The timers run on the CPU-time clock of each thread: a thread is
+ * interrupted hz times per second of CPU time it uses, idle threads are
+ * never interrupted.  The weight of a sample is the sampling period in
+ * nanoseconds.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class cpu_profiler : public basic_profiler< CallStack >
+{
+public:
+
+    /**
+     * @param hz       Samples per second of CPU time, per thread.
+     * @param signo    Signal delivered by the timers.
+     * @param flush_ms How often the background thread drains the rings.
+     */
+    explicit cpu_profiler(unsigned int hz = 100,
+                          int signo = SIGPROF,
+                          unsigned int flush_ms = 20)
+        : basic_profiler< CallStack >(detail::cpu_time, hz, signo, flush_ms)
+    {}
+}; //cpu_profiler
+
+
+/**
+ * Sampling wall-clock profiler: where the threads spend time, running or
+ * blocked (I/O, futexes, condition variables, sleeps).
+ *
+ * The timers run on the monotonic clock: every thread is interrupted hz
+ * times per second whatever its state, and the signal handler splits the
+ * time elapsed since the previous sample in on-CPU time (from the CPU-time
+ * clock of the thread) and off-CPU time.  The on-CPU time goes to
+ * profile(), the off-CPU time to off_cpu_profile(), both attributed to the
+ * interrupted stack: for a blocked thread, the call that blocks.
+ *
+ * Interrupted blocking calls are restarted (SA_RESTART) except those that
+ * never are, see signal(7); e.g. sleeps may return early with EINTR.
+ * Idle threads are sampled too, so keep hz low with many threads.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class wall_profiler : public basic_profiler< CallStack >
+{
+public:
+
+    /**
+     * @return the signal used by default: SIGRTMIN+4.
+     */
+    static int default_signal()
+    {
+        return SIGRTMIN + 4;
+    }
+
+    /**
+     * @param hz       Samples per second of elapsed time, per thread.
+     * @param signo    Signal delivered by the timers.
+     * @param flush_ms How often the background thread drains the rings.
+     */
+    explicit wall_profiler(unsigned int hz = 50,
+                           int signo = default_signal(),
+                           unsigned int flush_ms = 20)
+        : basic_profiler< CallStack >(detail::wall_time, hz, signo, flush_ms)
+    {}
+}; //wall_profiler
+
+
+/**
+ * Sampling CPU profiler built on perf events (perf_event_open(2)): the
+ * kernel records the user call chain of the sampled thread into a ring
+ * buffer, without interrupting it with a signal or running any code of
+ * ours in it.  Like \ref cpu_profiler, idle threads are not sampled.
+ *
+ * Samples are taken on CPU cycles if the hardware can count them, else
+ * (e.g. in virtual machines) on the CPU-time clock of the thread.  The
+ * weight of a sample is the nominal sampling period in nanoseconds.
+ *
+ * The kernel walks frame pointers: code compiled without them 
+ * (-fomit-frame-pointer, the default with optimization on x86_64) yields 
+ * truncated stacks.  Needs perf events to be allowed, see 
+ * /proc/sys/kernel/perf_event_paranoid; start() fails otherwise.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class perf_profiler : public basic_profiler< CallStack, detail::perf_sampler< CallStack > >
+{
+public:
+
+    /**
+     * @param hz       Samples per second of CPU time, per thread.
+     * @param hardware If true, sample CPU cycles if the hardware can.
+     * @param flush_ms How often the background thread drains the rings.
+     */
+    explicit perf_profiler(unsigned int hz = 100,
+                           bool hardware = true,
+                           unsigned int flush_ms = 20)
+        : basic_profiler< CallStack, detail::perf_sampler< CallStack > >(
+              hardware ? detail::cpu_cycles : detail::cpu_time, hz, 0, flush_ms)
+    {}
+}; //perf_profiler
+
+
+typedef cpu_profiler< default_stack >   default_cpu_profiler;
+typedef wall_profiler< default_stack >  default_wall_profiler;
+typedef perf_profiler< default_stack >  default_perf_profiler;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_PROFILER_HPP)
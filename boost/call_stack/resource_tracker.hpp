@@ -0,0 +1,373 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_RESOURCE_TRACKER_HPP)
+#define BOOST_CALL_STACK_RESOURCE_TRACKER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/resource_hooks.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <iostream>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * File descriptor and thread leak tracker: remembers the stack that
+ * created each live descriptor and each joinable thread, to report the
+ * ones left over by creation stack.
+ *
+ * Resources are seen through the hooks defined by the library: define
+ * BOOST_CALL_STACK_DEFINE_RESOURCE_HOOKS before including this header in
+ * exactly one translation unit of the program.  Without them, start()
+ * fails.  A descriptor is released by close(), a thread by pthread_join()
+ * or pthread_detach(): forgotten before the call, as the identifier can be
+ * reused as soon as it returns, and remembered again if it fails.
+ *
+ * Stacks are interned in a \ref stack_depot; descriptors index a table of
+ * stack ids, in lazily allocated chunks, updated without locks.  Threads,
+ * created seldom, are in a map under a lock.
+ *
+ * GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_resource_tracker
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef stack_depot< stack_type >        depot_type;
+    typedef typename depot_type::id_type     stack_id_type;
+
+    static const std::size_t max_fds = 1 << 18;   ///< higher descriptors are not tracked
+
+    /**
+     * Start tracking the resources created from now on.
+     * @return false if the hooks are not in the program.
+     */
+    static bool start()
+    {
+        if (!detail::resource_hooks::defined())
+        {
+            return false;
+        }
+        detail::resource_hooks::observe(&basic_resource_tracker::_on_fd, &basic_resource_tracker::_on_thread);
+        state().started = true;
+        return true;
+    }
+
+    /**
+     * Stop tracking new resources.  Releases are still seen, for a reused
+     * descriptor not to be reported with the stack of an earlier one.
+     */
+    static void stop()
+    {
+        state().started = false;
+    }
+
+    static bool running()
+    {
+        return state().started.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * @return the descriptors created since start() and still open, by
+     * creation stack.
+     */
+    static profile_type fd_profile()
+    {
+        detail::resource_hooks::scoped_guard guard;
+        state_type& st = state();
+        by_stack_type by_stack;
+        for (std::size_t c = 0; c < chunk_count; ++c)
+        {
+            const chunk_type* chunk = st.chunks[c].load(boost::memory_order_acquire);
+            for (std::size_t i = 0; chunk && i < chunk_size; ++i)
+            {
+                const stack_id_type id = chunk->ids[i].load(boost::memory_order_relaxed);
+                if (id)
+                {
+                    by_stack[id] += sample_value(1, 0);
+                }
+            }
+        }
+        return _profile(by_stack);
+    }
+
+    /**
+     * @return the threads created since start() neither joined nor
+     * detached, by creation stack.
+     */
+    static profile_type thread_profile()
+    {
+        detail::resource_hooks::scoped_guard guard;
+        state_type& st = state();
+        by_stack_type by_stack;
+        {
+            boost::mutex::scoped_lock lock(st.mutex);
+            for (typename threads_type::const_iterator it = st.threads.begin(); it != st.threads.end(); ++it)
+            {
+                by_stack[it->second] += sample_value(1, 0);
+            }
+        }
+        return _profile(by_stack);
+    }
+
+    /**
+     * @return the creation stack of a live descriptor, empty if unknown.
+     */
+    static const stack_type& fd_stack(int fd)
+    {
+        state_type& st = state();
+        const chunk_type* chunk = (fd >= 0 && std::size_t(fd) < max_fds)
+                                ? st.chunks[fd / chunk_size].load(boost::memory_order_acquire) : nullptr;
+        return st.depot.get(chunk ? chunk->ids[fd % chunk_size].load() : depot_type::null_id);
+    }
+
+    /**
+     * Forget the resources tracked so far.
+     */
+    static void clear()
+    {
+        state_type& st = state();
+        for (std::size_t c = 0; c < chunk_count; ++c)
+        {
+            chunk_type* chunk = st.chunks[c].load(boost::memory_order_acquire);
+            for (std::size_t i = 0; chunk && i < chunk_size; ++i)
+            {
+                chunk->ids[i].store(depot_type::null_id, boost::memory_order_relaxed);
+            }
+        }
+        boost::mutex::scoped_lock lock(st.mutex);
+        st.threads.clear();
+    }
+
+    /**
+     * Write the live descriptors and threads, by creation stack, most
+     * first: at most max_stacks stacks of each.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void report(std::ostream& os, std::size_t max_stacks = 20)
+    {
+        const profile_type fds     = fd_profile();
+        const profile_type threads = thread_profile();
+
+        detail::resource_hooks::scoped_guard guard;
+        symbol_cache< AddrResolver > cache;
+        _report< AddrResolver, OutputFormatter >(os, fds, "file descriptors", max_stacks, cache);
+        _report< AddrResolver, OutputFormatter >(os, threads, "threads", max_stacks, cache);
+        os << std::flush;
+    }
+
+private:
+
+    static const std::size_t chunk_size  = 4096;
+    static const std::size_t chunk_count = max_fds / chunk_size;
+
+    struct chunk_type
+    {
+        boost::atomic<stack_id_type>  ids[chunk_size];   ///< by descriptor; null_id: none
+
+        chunk_type()
+        {
+            for (std::size_t i = 0; i < chunk_size; ++i)
+            {
+                ids[i].store(depot_type::null_id, boost::memory_order_relaxed);
+            }
+        }
+    };
+
+    typedef boost::unordered_map< pthread_t, stack_id_type >      threads_type;
+    typedef boost::unordered_map< stack_id_type, sample_value >   by_stack_type;
+
+    struct state_type
+    {
+        boost::atomic<bool>           started;
+        depot_type                    depot;
+        boost::atomic<chunk_type*>    chunks[chunk_count];
+        boost::mutex                  mutex;       ///< guards threads
+        threads_type                  threads;
+
+        state_type() : started(false)
+        {
+            for (std::size_t c = 0; c < chunk_count; ++c)
+            {
+                chunks[c].store(nullptr, boost::memory_order_relaxed);
+            }
+        }
+    };
+
+    /*
+     * Never destroyed: resources can be released until the very end of the
+     * process.
+     */
+    static state_type& state()
+    {
+        static state_type* st = new state_type();
+        return *st;
+    }
+
+    static boost::atomic<stack_id_type>* _slot(int fd, bool create)
+    {
+        if (std::size_t(fd) >= max_fds)
+        {
+            return nullptr;
+        }
+        boost::atomic<chunk_type*>& entry = state().chunks[fd / chunk_size];
+        chunk_type* chunk = entry.load(boost::memory_order_acquire);
+        if (!chunk && create)
+        {
+            chunk_type* fresh = new chunk_type();
+            if (entry.compare_exchange_strong(chunk, fresh))
+            {
+                chunk = fresh;
+            }
+            else
+            {
+                delete fresh;
+            }
+        }
+        return chunk ? &chunk->ids[fd % chunk_size] : nullptr;
+    }
+
+    static void _on_fd(int fd, bool opened)
+    {
+        if (!opened)
+        {
+            boost::atomic<stack_id_type>* slot = _slot(fd, false);
+            if (slot)
+            {
+                slot->store(depot_type::null_id, boost::memory_order_relaxed);
+            }
+            return;
+        }
+        if (!running())
+        {
+            return;
+        }
+        boost::atomic<stack_id_type>* slot = _slot(fd, true);
+        if (slot)
+        {
+            slot->store(state().depot.capture(), boost::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * The record of the thread being joined or detached by the calling
+     * thread, put back if that fails.
+     */
+    struct released_type
+    {
+        pthread_t      thread;
+        stack_id_type  id;
+    };
+
+    static released_type& _released()
+    {
+        static __thread released_type rel;
+        return rel;
+    }
+
+    static void _on_thread(pthread_t thread, detail::resource_hooks::thread_event event)
+    {
+        state_type& st = state();
+        released_type& rel = _released();
+        if (event == detail::resource_hooks::thread_released)
+        {
+            boost::mutex::scoped_lock lock(st.mutex);
+            typename threads_type::iterator it = st.threads.find(thread);
+            rel.thread = thread;
+            rel.id     = (it != st.threads.end()) ? it->second : depot_type::null_id;
+            if (it != st.threads.end())
+            {
+                st.threads.erase(it);
+            }
+            return;
+        }
+        if (event == detail::resource_hooks::thread_kept)
+        {
+            if (rel.id != depot_type::null_id && ::pthread_equal(rel.thread, thread))
+            {
+                boost::mutex::scoped_lock lock(st.mutex);
+                st.threads[thread] = rel.id;
+            }
+            rel.id = depot_type::null_id;
+            return;
+        }
+        if (!running())
+        {
+            return;
+        }
+        const stack_id_type id = st.depot.capture();
+        boost::mutex::scoped_lock lock(st.mutex);
+        st.threads[thread] = id;
+    }
+
+    static profile_type _profile(const by_stack_type& by_stack)
+    {
+        profile_type ret;
+        for (typename by_stack_type::const_iterator it = by_stack.begin(); it != by_stack.end(); ++it)
+        {
+            ret.add(state().depot.get(it->first), it->second);
+        }
+        return ret;
+    }
+
+    template < typename AddrResolver, typename OutputFormatter >
+    static void _report(std::ostream& os, const profile_type& profile, const char* what,
+                        std::size_t max_stacks, symbol_cache< AddrResolver >& cache)
+    {
+        os << "Live " << what << ": " << std::dec << profile.total().count << " from "
+           << profile.size() << " stacks\n";
+
+        const std::vector<typename profile_type::entry_type> sorted = profile.sorted();
+        for (std::size_t i = 0; i < sorted.size() && i < max_stacks; ++i)
+        {
+            os << "\n" << sorted[i].second.count << " " << what << " created from:\n";
+            for (typename stack_type::const_iterator frm = sorted[i].first.begin(); frm != sorted[i].first.end(); ++frm)
+            {
+                OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+        }
+        os << "\n";
+    }
+}; //basic_resource_tracker
+
+
+typedef basic_resource_tracker< default_stack >  default_resource_tracker;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_RESOURCE_TRACKER_HPP)
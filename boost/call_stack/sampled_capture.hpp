@@ -0,0 +1,135 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_SAMPLED_CAPTURE_HPP)
+#define BOOST_CALL_STACK_SAMPLED_CAPTURE_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/rate_limiter.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * A place in code capturing the call stack for some of the times it runs:
+ * one time in every, by thread, and at most per_second times a second for
+ * the process.  Captured stacks go to a sink: a \ref stack_histogram, a
+ * \ref stack_profile or anything with a stack_type and add(stack, count,
+ * weight), thread-safe if the site runs in several threads.  The weight is
+ * every, the number of runs the capture stands for.
+ *
+ * Use it through \ref BOOST_CALL_STACK_CAPTURE_EVERY and \ref
+ * BOOST_CALL_STACK_CAPTURE_LIMITED: the runs not captured cost a decrement
+ * of a thread-local counter and a branch.
+ */
+class capture_site : private boost::noncopyable
+{
+public:
+
+    capture_site(boost::uint32_t every, boost::uint32_t per_second = 0)
+        : _every(every ? every : 1)
+        , _per_second(per_second)
+        , _captured(0)
+        , _limited(0)
+    {}
+
+    /**
+     * @param countdown Thread-local runs until the next capture.
+     * @return true if this run is to be captured.
+     */
+    bool tick(boost::int32_t& countdown)
+    {
+        if (__builtin_expect(--countdown > 0, 1))
+        {
+            return false;
+        }
+        countdown = static_cast<boost::int32_t>(_every);
+        return _admit();
+    }
+
+    /**
+     * Capture the stack of the caller into sink.
+     */
+    template < typename Sink >
+    void capture(Sink& sink)
+    {
+        typename Sink::stack_type stack;
+        stack.get_stack();
+        sink.add(stack, 1, _every);
+        ++_captured;
+    }
+
+    boost::uint32_t every()      const noexcept { return _every; }
+    boost::uint32_t per_second() const noexcept { return _per_second; }
+
+    /**
+     * @return the number of stacks captured, and of those not captured for
+     * the rate limit.
+     */
+    boost::uint64_t captured() const noexcept { return _captured.load(); }
+    boost::uint64_t limited()  const noexcept { return _limited.load(); }
+
+private:
+
+    bool _admit()
+    {
+        if (_limiter.admit(_per_second))
+        {
+            return true;
+        }
+        ++_limited;
+        return false;
+    }
+
+private:
+
+    const boost::uint32_t           _every;
+    const boost::uint32_t           _per_second;
+    detail::rate_limiter            _limiter;
+    boost::atomic<boost::uint64_t>  _captured;
+    boost::atomic<boost::uint64_t>  _limited;
+}; //capture_site
+
+
+}} //namespace boost::call_stack
+
+
+/**
+ * Capture the call stack into sink one time in n this line runs, by thread.
+ */
+#define BOOST_CALL_STACK_CAPTURE_EVERY(sink, n) \
+    BOOST_CALL_STACK_CAPTURE_LIMITED(sink, n, 0)
+
+/**
+ * Capture the call stack into sink one time in n this line runs, by thread,
+ * and at most k times a second (0: no limit).
+ */
+#define BOOST_CALL_STACK_CAPTURE_LIMITED(sink, n, k)                                   \
+    do {                                                                               \
+        static boost::call_stack::capture_site  boost_call_stack_site_((n), (k));      \
+        static __thread boost::int32_t          boost_call_stack_countdown_ = 0;      \
+        if (boost_call_stack_site_.tick(boost_call_stack_countdown_))                 \
+            boost_call_stack_site_.capture(sink);                                      \
+    } while (0)
+
+
+#endif //#if !defined(BOOST_CALL_STACK_SAMPLED_CAPTURE_HPP)
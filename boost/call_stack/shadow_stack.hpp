@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_SHADOW_STACK_HPP)
+#define BOOST_CALL_STACK_SHADOW_STACK_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/shadow_stack.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Capture from a shadow call stack: for code built with
+ * -finstrument-functions, each thread keeps the addresses of the functions
+ * it entered and has not exited yet, and capturing the stack copies them:
+ * no unwinding, a cost proportional to the depth only, and safe in signal
+ * handlers.
+ *
+ * The hooks maintaining it are defined by the library: define
+ * BOOST_CALL_STACK_DEFINE_SHADOW_STACK_HOOKS before including this header in
+ * exactly one translation unit of the program.  Define
+ * BOOST_CALL_STACK_USE_SHADOW_STACK for the whole program for
+ * call_stack::get_stack() to capture from it, everywhere in the library;
+ * when empty, it unwinds as usual.
+ *
+ * Frames are the entry addresses of the functions, not return addresses:
+ * they resolve to the function, without a line in it.  Functions not
+ * instrumented (libraries, the C library) are missing.  Each thread keeps
+ * its innermost BOOST_CALL_STACK_SHADOW_STACK_DEPTH (256 by default) frames;
+ * when outer ones are lost, call_stack::get_stack() unwinds instead.
+ * GCC on Linux only.
+ */
+class shadow_stack
+{
+public:
+
+    static const std::size_t capacity = detail::shadow_stack_hooks::capacity;
+
+    /**
+     * @return true if the hooks are linked in the program.
+     */
+    static bool defined()
+    {
+        return detail::shadow_stack_hooks::defined();
+    }
+
+    /**
+     * @return the number of instrumented functions the calling thread is in.
+     */
+    static std::size_t depth()
+    {
+        return detail::shadow_stack_hooks::depth();
+    }
+
+    /**
+     * Copy the shadow stack of the calling thread into stack, innermost
+     * function first: the frames kept, without the outermost beyond the
+     * capacity.  Async-signal-safe.
+     * @return the depth of stack; 0 if the shadow stack is empty.
+     */
+    template < typename CallStack >
+    static std::size_t get_stack(CallStack& stack)
+    {
+        address_type frames[capacity];
+        return stack.assign(frames, detail::shadow_stack_hooks::get_frames(frames, capacity));
+    }
+}; //shadow_stack
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_SHADOW_STACK_HPP)
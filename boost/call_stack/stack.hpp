@@ -27,6 +27,14 @@
 
 #include <boost/static_assert.hpp>
 #include <boost/move/move.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <utility>
 
 
 /*
@@ -151,6 +159,31 @@ public:
         return base_type::get_stack(); 
     }
 
+    /**
+     * Capture the call stack starting at the frame described by a register 
+     * state rather than at the caller: in a signal handler, given the 
+     * ucontext_t received by a SA_SIGINFO handler, the stack starts at the 
+     * interrupted instruction and the handler frames are left out.  On 
+     * Windows, given the CONTEXT of an exception.  The context must belong
+     * to the calling thread.
+     *
+     * Might return 0 if the stack cannot be walked from the given context.
+     */
+    depth_type get_stack(const context_type& ctx) 
+    { 
+        return base_type::get_stack(ctx); 
+    }
+
+    /**
+     * Set the call stack from return addresses obtained elsewhere, e.g. a 
+     * call chain recorded by the kernel.  The innermost frame comes first.
+     * Addresses past the max depth are dropped.
+     */
+    depth_type assign(const address_type* addrs, std::size_t count) 
+    { 
+        return base_type::assign(addrs, count); 
+    }
+
 }; //call_stack
 
 
@@ -161,6 +194,20 @@ void swap(call_stack<Size>& left, call_stack<Size>& right) noexcept
     left.swap(right);
 }
 
+/**
+ * For boost::hash: hash of the frame addresses.
+ */
+template < size_t Size > inline
+std::size_t hash_value(const call_stack<Size>& stk) noexcept
+{
+    std::size_t seed = stk.depth();
+    for (typename call_stack<Size>::const_iterator it = stk.begin(); it != stk.end(); ++it)
+    {
+        boost::hash_combine(seed, it->addr());
+    }
+    return seed;
+}
+
 
 /**
  * Binds together a \ref call_stack, a \ref symbol_resolver and 
@@ -239,6 +286,22 @@ public:
         return s.str();
     }
 
+    /**
+     * Allocation-free alternative to \ref as_string(); the symbol resolver
+     * might still allocate.  @see output_buffer
+     */
+    output_buffer& format(output_buffer& buf) const
+    {
+        for (typename stack_type::const_iterator iter = _stack.begin();
+            iter != _stack.end();
+            ++iter)
+        {
+            call_frame_formatter_type:: template print< symbol_resolver_type >(*iter, buf);
+            buf.append('\n');
+        }
+        return buf;
+    }
+
     /**
      *  An iterator yielding a \ref call_frame_info.
      */
@@ -333,6 +396,282 @@ void swap(call_stack_info<CallStack, AddrResolver, OutputFormatter >& left,
 }
 
 
+/**
+ * Same as \ref call_stack_info but the symbol information of all frames is
+ * resolved once, at construction, in one batch: each distinct address is
+ * resolved only once even if it appears in several frames (e.g. recursion).
+ * Printing, iterating and comparing afterwards use the stored results.
+ * Copies share the resolved information.  A collection of 
+ * \ref resolved_call_frame_info.
+ *
+ * @tparam CallStack       See \ref call_stack
+ * @tparam AddrResolver    See \ref symbol_resolver
+ * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+ *
+ */
+
+template < typename CallStack
+         , typename AddrResolver
+         , typename OutputFormatter
+         >
+class resolved_call_stack_info
+{
+public:
+
+    typedef CallStack              stack_type;
+    typedef AddrResolver           symbol_resolver_type;
+    typedef OutputFormatter        call_frame_formatter_type;
+    typedef resolved_call_frame_info< symbol_resolver_type
+                                    , call_frame_formatter_type> call_frame_info_type;
+
+    typedef typename stack_type::size_type  size_type;
+
+    // For containers
+    resolved_call_stack_info() 
+        : _stack(false) 
+        , _resolved(new resolved_type())
+    {}
+
+    resolved_call_stack_info(const stack_type& stack) 
+        : _stack(stack) 
+        , _resolved(new resolved_type())
+    {
+        _resolve();
+    }
+
+#if (__cplusplus >= 201103L) 
+    resolved_call_stack_info(resolved_call_stack_info&& other) noexcept 
+        : _stack(other._stack)
+        , _resolved(other._resolved)
+    {
+    }
+#endif
+
+    resolved_call_stack_info(const resolved_call_stack_info& other) noexcept 
+        : _stack(other._stack) 
+        , _resolved(other._resolved)
+    {}
+
+    resolved_call_stack_info& operator=(resolved_call_stack_info other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void swap(resolved_call_stack_info& other) noexcept
+    {
+        std::swap(_stack,    other._stack);
+        std::swap(_resolved, other._resolved);
+    }
+
+    const stack_type& stack() const noexcept { return _stack; }
+
+    size_type depth() const noexcept { return _stack.depth(); }
+    size_type size()  const noexcept { return depth(); }
+    bool      empty() const noexcept { return _stack.empty(); }
+
+    /**
+     * @return the symbol information of the frame at index idx.
+     */
+    const symbol_resolver_type& symbol(size_type idx) const
+    {
+        BOOST_ASSERT(idx < depth());
+        return _resolved->symbols[_resolved->index[idx]];
+    }
+
+    call_frame_info_type operator [] (size_type idx) const 
+    { 
+        return call_frame_info_type(_stack[idx], symbol(idx)); 
+    }
+
+    /**
+     * Number of distinct addresses that were resolved.
+     */
+    size_type resolved_count() const noexcept { return _resolved->symbols.size(); }
+
+    bool operator ==(const resolved_call_stack_info& other) const { return _stack == other._stack; }
+    bool operator !=(const resolved_call_stack_info& other) const { return _stack != other._stack; }
+
+    friend inline std::ostream& operator<<(std::ostream& os,
+                                           const resolved_call_stack_info& stk)
+    {
+        for (size_type i = 0; i < stk.depth(); ++i)
+        {
+            os << stk[i] << "\n";
+        }
+        os << std::flush;
+        return os;
+    }
+
+    std::string as_string() const
+    {
+        std::ostringstream s;
+        s << *this;
+        return s.str();
+    }
+
+    /**
+     * Allocation-free alternative to \ref as_string(). @see output_buffer
+     */
+    output_buffer& format(output_buffer& buf) const
+    {
+        for (size_type i = 0; i < depth(); ++i)
+        {
+            (*this)[i].format(buf).append('\n');
+        }
+        return buf;
+    }
+
+    /**
+     *  An iterator yielding a \ref resolved_call_frame_info.
+     */
+    class const_iterator
+    {
+    public:
+
+        typedef std::bidirectional_iterator_tag  iterator_category;
+        typedef call_frame_info_type             value_type;
+        typedef std::ptrdiff_t                   difference_type;
+        typedef const call_frame_info_type*      pointer;
+        typedef const call_frame_info_type&      reference;
+
+        const_iterator(const resolved_call_stack_info& owner, size_type idx)
+                : _owner(&owner)
+                , _idx(idx)
+        {
+            _update();
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return _owner == other._owner && _idx == other._idx;
+        }
+
+        bool operator!=(const const_iterator& x) const
+        {
+            return !(*this == x);
+        }
+
+        const call_frame_info_type& operator*() const
+        {
+            return _frame_info;
+        }
+        const call_frame_info_type* operator->() const
+        {
+            return &_frame_info;
+        }
+
+        const_iterator& operator++()
+        {
+            ++_idx;
+            _update();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        const_iterator& operator--()
+        {
+            --_idx;
+            _update();
+            return *this;
+        }
+        const_iterator operator--(int)
+        {
+            const_iterator tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+    private:
+
+        const_iterator();
+
+        void _update()
+        {
+            _frame_info = (_idx < _owner->depth()) ? (*_owner)[_idx] 
+                                                   : call_frame_info_type();
+        }
+
+    private:
+
+        const resolved_call_stack_info*  _owner;
+        size_type                        _idx;
+        call_frame_info_type             _frame_info;
+    }; //const_iterator
+
+    const_iterator begin()  const  { return const_iterator(*this, 0); }
+    const_iterator cbegin() const  { return begin(); }
+    const_iterator end()    const  { return const_iterator(*this, depth()); }
+    const_iterator cend()   const  { return end(); }
+
+private:
+
+    // Resolvers re-resolve when copied: resolve in place, never copy them.
+    struct resolved_type
+    {
+        std::vector< symbol_resolver_type >  symbols;
+        std::vector< size_type >             index;   ///< frame -> symbols
+    };
+
+    void _resolve()
+    {
+        const size_type depth = _stack.depth();
+
+        // Batch: sort the frames by address to resolve each address once
+        std::vector< std::pair<address_type, size_type> > order;
+        order.reserve(depth);
+        for (size_type i = 0; i < depth; ++i)
+        {
+            order.push_back(std::make_pair(_stack[i].addr(), i));
+        }
+        std::sort(order.begin(), order.end());
+
+        resolved_type& res = *_resolved;
+        res.index.resize(depth);
+
+        size_type unique = 0;
+        for (size_type i = 0; i < depth; ++i)
+        {
+            if (i == 0 || order[i].first != order[i-1].first)
+            {
+                ++unique;
+            }
+            res.index[order[i].second] = unique - 1;
+        }
+
+        res.symbols.resize(unique);
+        for (size_type i = 0, u = 0; i < depth; ++i)
+        {
+            if (i == 0 || order[i].first != order[i-1].first)
+            {
+                res.symbols[u++].resolve(order[i].first);
+            }
+        }
+    }
+
+private:
+
+    stack_type                                  _stack;
+    boost::shared_ptr< resolved_type >          _resolved;
+}; //resolved_call_stack_info
+
+template < typename CallStack
+         , typename AddrResolver
+         , typename OutputFormatter
+         > inline
+void swap(resolved_call_stack_info<CallStack, AddrResolver, OutputFormatter >& left, 
+          resolved_call_stack_info<CallStack, AddrResolver, OutputFormatter >& right) noexcept
+{
+    BOOST_ASSERT(&left != &right);
+    left.swap(right);
+}
+
+
 }} //namespace boost::call_stack
 
 
@@ -357,6 +696,17 @@ void swap(boost::call_stack::call_stack_info<CallStack, AddrResolver, OutputForm
 }
 
 
+template < typename CallStack
+         , typename AddrResolver
+         , typename OutputFormatter
+         > inline
+void swap(boost::call_stack::resolved_call_stack_info<CallStack, AddrResolver, OutputFormatter>& left, 
+          boost::call_stack::resolved_call_stack_info<CallStack, AddrResolver, OutputFormatter>& right) noexcept
+{
+    boost::call_stack::swap(left, right);
+}
+
+
 } //namespace std
 
 #endif //#if !defined(BOOST_CALL_STACK_STACK_HPP)
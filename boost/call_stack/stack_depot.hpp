@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_STACK_DEPOT_HPP)
+#define BOOST_CALL_STACK_STACK_DEPOT_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <deque>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Interns call stacks: each distinct stack is stored once and gets a small
+ * id, stable for the life of the depot.  Events, locks, objects etc. can
+ * then refer to a stack by id for 4 bytes instead of a copy of it.
+ *
+ * Thread-safe; stacks are spread over shards by hash, each with its own
+ * lock.  Stacks are never removed.  Id 0 is never used (no stack).
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class stack_depot : private boost::noncopyable
+{
+public:
+
+    typedef CallStack        stack_type;
+    typedef boost::uint32_t  id_type;
+
+    static const id_type     null_id = 0;
+
+    stack_depot() {}
+
+    /**
+     * @return the id of stack, stored on first sight.  Empty stacks get
+     * null_id.
+     */
+    id_type intern(const stack_type& stack)
+    {
+        if (stack.empty())
+        {
+            return null_id;
+        }
+
+        const std::size_t hash = boost::hash<stack_type>()(stack);
+        const std::size_t idx  = hash % shard_count;
+        shard_type& shard = _shards[idx];
+
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename ids_type::const_iterator it = shard.ids.find(stack);
+        if (it != shard.ids.end())
+        {
+            return it->second;
+        }
+        shard.stacks.push_back(stack);
+        const id_type id = static_cast<id_type>((shard.stacks.size() << shard_bits) | idx);
+        shard.ids.insert(typename ids_type::value_type(stack, id));
+        return id;
+    }
+
+    /**
+     * Capture the stack of the caller and intern it.
+     */
+    id_type capture()
+    {
+        stack_type stack;
+        stack.get_stack();
+        return intern(stack);
+    }
+
+    /**
+     * @return the stack of id, an empty stack for null_id or unknown ids.
+     * The reference is valid for the life of the depot.
+     */
+    const stack_type& get(id_type id) const
+    {
+        static const stack_type empty;
+
+        const std::size_t idx = id & (shard_count - 1);
+        const std::size_t pos = id >> shard_bits;
+        const shard_type& shard = _shards[idx];
+
+        boost::mutex::scoped_lock lock(shard.mutex);
+        return (pos > 0 && pos <= shard.stacks.size()) ? shard.stacks[pos - 1] : empty;
+    }
+
+    /**
+     * @return the number of distinct stacks.
+     */
+    std::size_t size() const
+    {
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(_shards[i].mutex);
+            ret += _shards[i].stacks.size();
+        }
+        return ret;
+    }
+
+private:
+
+    static const std::size_t shard_bits  = 4;
+    static const std::size_t shard_count = 1 << shard_bits;
+
+    typedef boost::unordered_map< stack_type
+                                , id_type
+                                , boost::hash<stack_type> >  ids_type;
+
+    struct shard_type
+    {
+        mutable boost::mutex     mutex;
+        ids_type                 ids;
+        std::deque<stack_type>   stacks;   ///< push_back() keeps references valid
+    };
+
+    shard_type  _shards[shard_count];
+}; //stack_depot
+
+
+typedef stack_depot< default_stack >  default_stack_depot;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_STACK_DEPOT_HPP)
@@ -0,0 +1,202 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_STACK_HISTOGRAM_HPP)
+#define BOOST_CALL_STACK_STACK_HISTOGRAM_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/profile.hpp>
+
+#include <boost/config.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Counts how often each distinct call stack occurs, and sums a weight for
+ * it, from many threads at once.
+ *
+ * Stacks are spread by hash over shards, each on its own cache lines with
+ * its own lock: threads adding different stacks seldom contend, and never
+ * on a global lock.  The hash of a stack is computed once per add().
+ * \ref take() snapshots and resets the counts, for periodic reports.
+ *
+ * It is a sink for \ref BOOST_CALL_STACK_CAPTURE_EVERY & co.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class stack_histogram : private boost::noncopyable
+{
+public:
+
+    typedef CallStack                        stack_type;
+    typedef stack_profile< stack_type >      profile_type;
+    typedef std::size_t                      size_type;
+
+    static const std::size_t shard_count = 64;
+
+    stack_histogram() {}
+
+    void add(const stack_type& stack, boost::uint64_t count = 1, boost::uint64_t weight = 0)
+    {
+        const key_type key(stack);
+        shard_type& shard = _shards[key.hash % shard_count];
+        boost::mutex::scoped_lock lock(shard.mutex);
+        shard.stacks[key] += sample_value(count, weight);
+    }
+
+    /**
+     * Capture the stack of the caller and add it.
+     */
+    void capture(boost::uint64_t count = 1, boost::uint64_t weight = 0)
+    {
+        stack_type stack;
+        stack.get_stack();
+        add(stack, count, weight);
+    }
+
+    /**
+     * @return the value accumulated for stack, zero if not seen.
+     */
+    sample_value value(const stack_type& stack) const
+    {
+        const key_type key(stack);
+        const shard_type& shard = _shards[key.hash % shard_count];
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename map_type::const_iterator it = shard.stacks.find(key);
+        return it != shard.stacks.end() ? it->second : sample_value();
+    }
+
+    /**
+     * @return the counts so far.
+     */
+    profile_type snapshot() const
+    {
+        profile_type ret;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(_shards[i].mutex);
+            _copy(_shards[i].stacks, ret);
+        }
+        return ret;
+    }
+
+    /**
+     * @return the counts so far, and reset them.  Shards are reset one at a
+     * time: an add() lands either in the result or in the next one.
+     */
+    profile_type take()
+    {
+        profile_type ret;
+        map_type stacks;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            {
+                boost::mutex::scoped_lock lock(_shards[i].mutex);
+                stacks.swap(_shards[i].stacks);
+            }
+            _copy(stacks, ret);
+            stacks.clear();
+        }
+        return ret;
+    }
+
+    /**
+     * @return the number of distinct stacks.
+     */
+    size_type size() const
+    {
+        size_type ret = 0;
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(_shards[i].mutex);
+            ret += _shards[i].stacks.size();
+        }
+        return ret;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    void clear()
+    {
+        for (std::size_t i = 0; i < shard_count; ++i)
+        {
+            boost::mutex::scoped_lock lock(_shards[i].mutex);
+            _shards[i].stacks.clear();
+        }
+    }
+
+private:
+
+    /*
+     * A stack and its hash, computed once.
+     */
+    struct key_type
+    {
+        stack_type   stack;
+        std::size_t  hash;
+
+        explicit key_type(const stack_type& stk)
+            : stack(stk)
+            , hash(boost::hash<stack_type>()(stk))
+        {}
+
+        bool operator==(const key_type& other) const
+        {
+            return hash == other.hash && stack == other.stack;
+        }
+    };
+
+    struct key_hash
+    {
+        std::size_t operator()(const key_type& key) const { return key.hash; }
+    };
+
+    typedef boost::unordered_map< key_type, sample_value, key_hash >  map_type;
+
+    struct BOOST_ALIGNMENT(64) shard_type
+    {
+        mutable boost::mutex  mutex;
+        map_type              stacks;
+    };
+
+    static void _copy(const map_type& stacks, profile_type& out)
+    {
+        for (typename map_type::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+        {
+            out.add(it->first.stack, it->second);
+        }
+    }
+
+private:
+
+    shard_type  _shards[shard_count];
+}; //stack_histogram
+
+
+typedef stack_histogram< default_stack >  default_stack_histogram;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_STACK_HISTOGRAM_HPP)
@@ -0,0 +1,499 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_STALL_WATCHDOG_HPP)
+#define BOOST_CALL_STACK_STALL_WATCHDOG_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <signal.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * A thread that stopped making progress for longer than the budget of a
+ * \ref basic_stall_watchdog, and the stacks it was found stalled in.
+ */
+template < typename CallStack >
+struct thread_stall
+{
+    typedef CallStack  stack_type;
+
+    detail::thread_id_type   tid;
+    std::string              name;
+    boost::uint64_t          start_ns;      ///< monotonic, when last seen making progress
+    boost::uint64_t          duration_ns;
+    std::vector<stack_type>  stacks;        ///< oldest first
+
+    thread_stall() : tid(0), start_ns(0), duration_ns(0) {}
+};
+
+
+/**
+ * Stall watchdog: finds the threads that block for longer than a budget,
+ * and where.
+ *
+ * Watched threads publish heartbeats: \ref heartbeat::beat() when making
+ * progress (e.g. at each turn of an event loop), \ref heartbeat::idle()
+ * before waiting legitimately (e.g. for events).  Either is a load and a
+ * store to memory of the thread, no clock read.  A monitor thread checks
+ * the heartbeats every check_ms; a thread neither idle nor beating for the
+ * budget is stalled: it is signalled to capture its own stack, as for a
+ * \ref thread_dump, at every check while it stays stalled.  The stall is
+ * reported when the thread beats again, or goes idle; until then, it is
+ * among the ongoing_stalls().  Stacks are captured
+ * and stalls reported without holding the watchdog's lock.
+ *
+ * GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_stall_watchdog : private boost::noncopyable
+{
+public:
+
+    typedef CallStack                                   stack_type;
+    typedef thread_stall< stack_type >                  stall_type;
+    typedef boost::function< void (const stall_type&) > handler_type;
+
+    /**
+     * Heartbeat of one watched thread, written only by that thread.
+     */
+    class heartbeat : private boost::noncopyable
+    {
+    public:
+
+        /**
+         * The thread made progress.
+         */
+        void beat()
+        {
+            _word.store((_word.load(boost::memory_order_relaxed) | 1) + 1, boost::memory_order_relaxed);
+        }
+
+        /**
+         * The thread is about to wait legitimately, until the next beat().
+         */
+        void idle()
+        {
+            _word.store(_word.load(boost::memory_order_relaxed) | 1, boost::memory_order_relaxed);
+        }
+
+        detail::thread_id_type tid() const noexcept { return _tid; }
+
+    private:
+
+        friend class basic_stall_watchdog;
+
+        heartbeat()
+            : _tid(detail::current_thread_id())
+            , _word(0)
+            , _last_word(0)
+            , _last_change_ns(detail::monotonic_ns())
+            , _stalled(false)
+        {}
+
+        const detail::thread_id_type    _tid;
+        boost::atomic<boost::uint64_t>  _word;          ///< beats * 2, low bit: idle
+
+        // Monitor only
+        boost::uint64_t                 _last_word;
+        boost::uint64_t                 _last_change_ns;
+        bool                            _stalled;
+        stall_type                      _stall;
+    }; //heartbeat
+
+    /**
+     * @return the signal used by default: SIGRTMIN+5.
+     */
+    static int default_signal()
+    {
+        return SIGRTMIN + 5;
+    }
+
+    /**
+     * @param budget_ms  A thread not beating for that long is stalled.
+     * @param check_ms   How often the heartbeats are checked, and stacks of
+     *                   stalled threads captured; 0: budget_ms / 2.
+     * @param signo      The signal used to interrupt stalled threads.
+     * @param max_stacks Stacks kept per stall.
+     */
+    explicit basic_stall_watchdog(unsigned int budget_ms,
+                                  unsigned int check_ms = 0,
+                                  int signo = default_signal(),
+                                  std::size_t max_stacks = 16)
+        : _budget_ns(budget_ms * 1000000ull)
+        , _check_ms(check_ms ? check_ms : std::max(budget_ms / 2, 1u))
+        , _signo(signo)
+        , _max_stacks(max_stacks)
+        , _running(false)
+        , _stop(false)
+    {}
+
+    ~basic_stall_watchdog()
+    {
+        stop();
+    }
+
+    /**
+     * Start the monitor thread.
+     * @return true if successful.
+     */
+    bool start()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_running)
+        {
+            return true;
+        }
+        if (!capture_type::install(_signo))
+        {
+            return false;
+        }
+        _stop    = false;
+        _thread  = boost::thread(&basic_stall_watchdog::_run, this);
+        _running = true;
+        return true;
+    }
+
+    /**
+     * Stop the monitor thread.  Ongoing stalls are reported.
+     */
+    void stop()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            if (!_running)
+            {
+                return;
+            }
+            _stop = true;
+            _wakeup.notify_all();
+        }
+        _thread.join();
+
+        std::vector<stall_type> ended;
+        handler_type            handler;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            const boost::uint64_t now = detail::monotonic_ns();
+            for (std::size_t i = 0; i < _watched.size(); ++i)
+            {
+                _end_stall(*_watched[i], now, ended);
+            }
+            _running = false;
+            handler  = _handler;
+        }
+        _notify(handler, ended);
+    }
+
+    bool running() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _running;
+    }
+
+    /**
+     * Watch the calling thread.  The heartbeat stays valid until unwatch().
+     */
+    heartbeat& watch()
+    {
+        boost::shared_ptr<heartbeat> hb(new heartbeat());
+        boost::mutex::scoped_lock lock(_mutex);
+        _watched.push_back(hb);
+        return *hb;
+    }
+
+    /**
+     * Stop watching a thread, e.g. before it ends.  An ongoing stall is
+     * reported.
+     */
+    void unwatch(heartbeat& hb)
+    {
+        std::vector<stall_type> ended;
+        handler_type            handler;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            for (typename watched_type::iterator it = _watched.begin(); it != _watched.end(); ++it)
+            {
+                if (it->get() == &hb)
+                {
+                    _end_stall(hb, detail::monotonic_ns(), ended);
+                    _watched.erase(it);
+                    break;
+                }
+            }
+            handler = _handler;
+        }
+        _notify(handler, ended);
+    }
+
+    /**
+     * Set the function called for each stall when it ends: on the monitor
+     * thread, or on the thread calling stop() or unwatch() for a stall
+     * ongoing then.  It is called without the watchdog's lock, and can
+     * call any member but stop().
+     */
+    void on_stall(const handler_type& handler)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _handler = handler;
+    }
+
+    /**
+     * @return the stalls ended so far.
+     */
+    std::vector<stall_type> stalls() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _stalls;
+    }
+
+    /**
+     * @return the stalls not ended yet, e.g. of threads deadlocked, with
+     * their duration and the stacks captured so far.
+     */
+    std::vector<stall_type> ongoing_stalls() const
+    {
+        std::vector<stall_type> ret;
+        boost::mutex::scoped_lock lock(_mutex);
+        const boost::uint64_t now = detail::monotonic_ns();
+        for (std::size_t i = 0; i < _watched.size(); ++i)
+        {
+            if (_watched[i]->_stalled)
+            {
+                ret.push_back(_watched[i]->_stall);
+                ret.back().duration_ns = now - ret.back().start_ns;
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * @return the stalls ended so far, and forget them.
+     */
+    std::vector<stall_type> take_stalls()
+    {
+        std::vector<stall_type> ret;
+        boost::mutex::scoped_lock lock(_mutex);
+        ret.swap(_stalls);
+        return ret;
+    }
+
+    /**
+     * Write a stall and its stacks.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+     */
+    template < typename AddrResolver, typename OutputFormatter >
+    static void write(std::ostream& os, const stall_type& stall)
+    {
+        os << "Thread " << std::dec << stall.tid << " \"" << stall.name << "\" stalled for "
+           << stall.duration_ns / 1000000 << " ms, " << stall.stacks.size() << " stacks:\n";
+        symbol_cache< AddrResolver > cache;
+        for (std::size_t i = 0; i < stall.stacks.size(); ++i)
+        {
+            if (i && stall.stacks[i] == stall.stacks[i - 1])
+            {
+                os << "  (same)\n";
+                continue;
+            }
+            os << "  #" << i << "\n";
+            for (typename stack_type::const_iterator frm = stall.stacks[i].begin(); frm != stall.stacks[i].end(); ++frm)
+            {
+                os << "    ";
+                OutputFormatter:: template print< AddrResolver >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+        }
+        os << std::flush;
+    }
+
+private:
+
+    typedef detail::thread_capture< stack_type >         capture_type;
+    typedef std::vector< boost::shared_ptr<heartbeat> >  watched_type;
+
+    typedef std::pair< boost::shared_ptr<heartbeat>, stack_type >  capture_result_type;
+
+    void _run()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        while (!_stop)
+        {
+            _wakeup.timed_wait(lock, boost::posix_time::milliseconds(_check_ms));
+            if (_stop)
+                break;
+
+            std::vector<stall_type> ended;
+            watched_type            stalled;
+            _check(ended, stalled);
+            const handler_type handler = _handler;
+            lock.unlock();
+
+            // Stalled threads can take up to check_ms each to answer
+            std::vector<capture_result_type> captured;
+            for (std::size_t i = 0; i < stalled.size(); ++i)
+            {
+                capture_result_type res(stalled[i], stack_type());
+                if (_capture(stalled[i]->_tid, res.second))
+                {
+                    captured.push_back(res);
+                }
+            }
+            _notify(handler, ended);
+
+            lock.lock();
+            for (std::size_t i = 0; i < captured.size(); ++i)
+            {
+                // Still the same stall: the stall of an unwatched thread ended
+                heartbeat& hb = *captured[i].first;
+                if (hb._stalled && hb._stall.stacks.size() < _max_stacks)
+                {
+                    hb._stall.stacks.push_back(captured[i].second);
+                }
+            }
+        }
+    }
+
+    /*
+     * Under _mutex: end the stalls of the threads that made progress, and
+     * list the threads stalled whose stacks are to be captured.
+     */
+    void _check(std::vector<stall_type>& ended, watched_type& stalled)
+    {
+        const boost::uint64_t now = detail::monotonic_ns();
+        for (std::size_t i = 0; i < _watched.size(); ++i)
+        {
+            heartbeat& hb = *_watched[i];
+            const boost::uint64_t word = hb._word.load(boost::memory_order_relaxed);
+            if (word != hb._last_word || (word & 1))
+            {
+                _end_stall(hb, now, ended);
+                hb._last_word      = word;
+                hb._last_change_ns = now;
+                continue;
+            }
+            if (now - hb._last_change_ns < _budget_ns)
+            {
+                continue;
+            }
+
+            if (!hb._stalled)
+            {
+                hb._stalled = true;
+                hb._stall   = stall_type();
+                hb._stall.tid      = hb._tid;
+                hb._stall.name     = detail::thread_name(hb._tid);
+                hb._stall.start_ns = hb._last_change_ns;
+            }
+            if (hb._stall.stacks.size() < _max_stacks)
+            {
+                stalled.push_back(_watched[i]);
+            }
+        }
+    }
+
+    /**
+     * Not under _mutex.
+     * @return true if the thread captured its stack within check_ms.
+     */
+    bool _capture(detail::thread_id_type tid, stack_type& stack)
+    {
+        typename capture_type::slot_type* slot = capture_type::acquire();
+        if (!slot)
+        {
+            return false;
+        }
+        const boost::uint64_t deadline = detail::monotonic_ns() + _check_ms * 1000000ull;
+        const bool ret = capture_type::request(*slot, tid, _signo) && capture_type::wait(*slot, deadline);
+        if (ret)
+        {
+            stack = slot->stack;
+        }
+        capture_type::release(slot);
+        return ret;
+    }
+
+    // Under _mutex
+    void _end_stall(heartbeat& hb, boost::uint64_t now, std::vector<stall_type>& ended)
+    {
+        if (!hb._stalled)
+        {
+            return;
+        }
+        hb._stalled = false;
+        hb._stall.duration_ns = now - hb._stall.start_ns;
+        _stalls.push_back(hb._stall);
+        ended.push_back(hb._stall);
+    }
+
+    // Not under _mutex
+    static void _notify(const handler_type& handler, const std::vector<stall_type>& ended)
+    {
+        for (std::size_t i = 0; handler && i < ended.size(); ++i)
+        {
+            handler(ended[i]);
+        }
+    }
+
+private:
+
+    const boost::uint64_t         _budget_ns;
+    const unsigned int            _check_ms;
+    const int                     _signo;
+    const std::size_t             _max_stacks;
+
+    mutable boost::mutex          _mutex;
+    boost::condition_variable     _wakeup;
+    boost::thread                 _thread;
+    bool                          _running;
+    bool                          _stop;
+
+    watched_type                  _watched;
+    std::vector<stall_type>       _stalls;
+    handler_type                  _handler;
+}; //basic_stall_watchdog
+
+
+typedef basic_stall_watchdog< default_stack >  default_stall_watchdog;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_STALL_WATCHDOG_HPP)
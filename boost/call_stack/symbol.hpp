@@ -22,6 +22,12 @@
 
 #include <boost/static_assert.hpp>
 #include <boost/move/move.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <map>
 
 
 /*
@@ -40,6 +46,8 @@ static const address_type           null_address = detail::null_address;
 typedef detail::delta_type          delta_type;
 static const delta_type             null_delta = detail::null_delta;
 
+typedef detail::context_type        context_type;   ///< Platform register state: ucontext_t, CONTEXT
+
 
 /**
  *  Adapters for the address of an object or function.  Not for methods,
@@ -61,6 +69,160 @@ address_type addressof(const T* arg) {
     return addr;
 }
 
+/**
+ * Appends characters to a caller-supplied buffer. Never allocates, never
+ * overflows: the output is truncated to fit and is always NUL-terminated.
+ * Integers are formatted without locale nor stream state.  The formatters 
+ * produce the same bytes as their std::ostream counterparts.
+ */
+class output_buffer
+{
+public:
+
+    output_buffer(char* buf, std::size_t size) noexcept
+        : _buf(buf)
+        , _size(size)
+        , _len(0)
+        , _truncated(false)
+    {
+        BOOST_ASSERT(buf && size > 0);
+        _buf[0] = '\0';
+    }
+
+    const char*  c_str()     const noexcept { return _buf; }
+    std::size_t  size()      const noexcept { return _len; }
+    std::size_t  capacity()  const noexcept { return _size - 1; }
+    bool         truncated() const noexcept { return _truncated; }
+
+    void clear() noexcept
+    {
+        _len = 0;
+        _truncated = false;
+        _buf[0] = '\0';
+    }
+
+    output_buffer& append(char c) noexcept
+    {
+        if (_len < capacity()) {
+            _buf[_len++] = c;
+            _buf[_len] = '\0';
+        }
+        else {
+            _truncated = true;
+        }
+        return *this;
+    }
+
+    output_buffer& append(const char* str, std::size_t len) noexcept
+    {
+        std::size_t avail = capacity() - _len;
+        if (len > avail) {
+            len = avail;
+            _truncated = true;
+        }
+        std::memcpy(_buf + _len, str, len);
+        _len += len;
+        _buf[_len] = '\0';
+        return *this;
+    }
+
+    output_buffer& append(const char* str) noexcept
+    {
+        return append(str, std::strlen(str));
+    }
+
+    /**
+     * Decimal digits.  Non-negative values only.
+     */
+    template < typename Integer >
+    output_buffer& append_dec(Integer ival) noexcept
+    {
+        BOOST_STATIC_ASSERT_MSG(boost::is_integral<Integer>::value, "Integer must be integral");
+        typedef typename boost::make_unsigned<Integer>::type  unsigned_type;
+        unsigned_type val = static_cast<unsigned_type>(ival);
+        char  tmp[3 * sizeof(val)];
+        char* p = tmp + sizeof(tmp);
+        do {
+            *--p = static_cast<char>('0' + val % 10);
+            val /= 10;
+        } while (val);
+        return append(p, static_cast<std::size_t>(tmp + sizeof(tmp) - p));
+    }
+
+    /**
+     * Lowercase hexadecimal digits, no prefix.  As with std::hex, a negative 
+     * value is printed as its two's complement.
+     */
+    template < typename Integer >
+    output_buffer& append_hex(Integer ival) noexcept
+    {
+        BOOST_STATIC_ASSERT_MSG(boost::is_integral<Integer>::value, "Integer must be integral");
+        typedef typename boost::make_unsigned<Integer>::type  unsigned_type;
+        unsigned_type val = static_cast<unsigned_type>(ival);
+        static const char digits[] = "0123456789abcdef";
+        char  tmp[2 * sizeof(val)];
+        char* p = tmp + sizeof(tmp);
+        do {
+            *--p = digits[val & 0xf];
+            val >>= 4;
+        } while (val);
+        return append(p, static_cast<std::size_t>(tmp + sizeof(tmp) - p));
+    }
+
+    /**
+     * Same as std::ostream << const void*: "0x" prefix except for null.
+     */
+    output_buffer& append_address(const void* addr) noexcept
+    {
+        std::size_t val = reinterpret_cast<std::size_t>(addr);
+        if (val) {
+            append("0x", 2);
+        }
+        return append_hex(val);
+    }
+
+    /**
+     * Same as std::ostream << std::hex << integer.
+     */
+    output_buffer& append_address(boost::ulong_long_type addr) noexcept
+    {
+        return append_hex(addr);
+    }
+
+private:
+
+    char*        _buf;
+    std::size_t  _size;
+    std::size_t  _len;
+    bool         _truncated;
+}; //output_buffer
+
+
+/**
+ * An \ref output_buffer with its own storage.
+ */
+template < std::size_t Size >
+class fixed_output_buffer : public output_buffer
+{
+    BOOST_STATIC_ASSERT_MSG(Size > 0, "Size must be positive");
+
+public:
+
+    fixed_output_buffer() noexcept
+        : output_buffer(_storage, Size)
+    {}
+
+private:
+
+    fixed_output_buffer(const fixed_output_buffer&);
+    fixed_output_buffer& operator=(const fixed_output_buffer&);
+
+private:
+
+    char _storage[Size];
+};
+
+
 /**
  *  Symbol resolver interface to plaftorm-specific resolvers.
  */
@@ -152,6 +314,17 @@ public:
         OutputFormatter::print(*this, s);
         return s.str();
     }
+
+    /**
+     * Allocation-free alternative to \ref as_string(). 
+     * @see output_buffer
+     */
+    template < typename OutputFormatter >
+    output_buffer& format(output_buffer& buf) const
+    {
+        OutputFormatter::print(*this, buf);
+        return buf;
+    }
 }; //symbol_resolver
 
 
@@ -263,6 +436,16 @@ public:
         s << *this;
         return s.str();
     }
+
+    /**
+     * Allocation-free alternative to \ref as_string(). 
+     * @see output_buffer
+     */
+    output_buffer& format(output_buffer& buf) const
+    {
+        symbol_formatter_type:: template print< symbol_resolver_type >(*this, buf);
+        return buf;
+    }
 };
 
 template < typename AddrResolver
@@ -276,6 +459,57 @@ void swap(symbol_info< AddrResolver, OutputFormatter >& left,
 }
 
 
+/**
+ * Resolves each distinct address once and keeps the results.  Useful when
+ * many call stacks sharing frames are output together.  Not thread-safe.
+ *
+ * @tparam AddrResolver    See \ref symbol_resolver
+ */
+
+template < typename AddrResolver >
+class symbol_cache
+{
+public:
+
+    typedef AddrResolver                                 symbol_resolver_type;
+    typedef std::map< address_type, symbol_resolver_type >  map_type;
+    typedef typename map_type::size_type                 size_type;
+
+    /**
+     * @return the symbol information for addr, resolved on first request. 
+     * The reference stays valid until \ref clear() is called.
+     */
+    const symbol_resolver_type& resolve(const address_type& addr)
+    {
+        typename map_type::iterator it = _syms.lower_bound(addr);
+        if (it == _syms.end() || it->first != addr)
+        {
+            // Resolvers re-resolve when copied: resolve in place.
+            it = _syms.insert(it, typename map_type::value_type(addr, symbol_resolver_type()));
+            it->second.resolve(addr);
+        }
+        return it->second;
+    }
+
+    size_type size()  const noexcept { return _syms.size(); }
+    bool      empty() const noexcept { return _syms.empty(); }
+
+    void clear() 
+    { 
+        _syms.clear(); 
+    }
+
+    void swap(symbol_cache& other) noexcept
+    {
+        _syms.swap(other._syms);
+    }
+
+private:
+
+    map_type  _syms;
+}; //symbol_cache
+
+
 /**
  * How to format \ref symbol_info information.
  */
@@ -292,6 +526,18 @@ struct terse_symbol_formatter
            << " in " << sym.source_file() << ":" << std::dec << sym.line_number()
            ;
     }
+
+    template < typename SymbolResolver > 
+    static void print(SymbolResolver const& sym, output_buffer& buf)
+    {
+        buf.append('[').append_address(sym.addr()).append("] ")
+           .append(sym.demangled_name())
+           .append(sym.delta() >= 0 ? '+' : '-')
+           .append("0x").append_hex(sym.delta())
+           .append(" (").append(sym.binary_file()).append(")")
+           .append(" in ").append(sym.source_file()).append(':').append_dec(sym.line_number())
+           ;
+    }
 };
 
 
@@ -311,6 +557,18 @@ struct fancy_symbol_formatter
            << "\n\tIn " << sym.binary_file()
            ;
     }
+
+    template < typename SymbolResolver > 
+    static void print(SymbolResolver const& sym, output_buffer& buf)
+    {
+        buf.append('[').append_address(sym.addr()).append("] ")
+           .append(sym.demangled_name())
+           .append(sym.delta() >= 0 ? '+' : '-')
+           .append("0x").append_hex(sym.delta())
+           .append("\n\tAt ").append(sym.source_file()).append(':').append_dec(sym.line_number())
+           .append("\n\tIn ").append(sym.binary_file())
+           ;
+    }
 };
 
 
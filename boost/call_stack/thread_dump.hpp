@@ -0,0 +1,243 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_THREAD_DUMP_HPP)
+#define BOOST_CALL_STACK_THREAD_DUMP_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+typedef detail::thread_id_type  thread_id_type;
+
+/**
+ * The call stack of one thread in a \ref thread_dump.
+ */
+template < typename CallStack >
+struct thread_stack
+{
+    typedef CallStack  stack_type;
+
+    thread_id_type   tid;
+    std::string      name;
+    bool             captured;   ///< false if the thread did not answer in time
+    unsigned long    pause_us;   ///< time the thread spent capturing its stack
+    stack_type       stack;
+
+    thread_stack()
+        : tid(0)
+        , captured(false)
+        , pause_us(0)
+    {}
+};
+
+
+/**
+ * Snapshot of the call stacks of all the threads of the process.
+ *
+ * Threads are listed from /proc/self/task.  Each thread other than the
+ * calling one is sent a dedicated real-time signal and captures its own
+ * stack from its signal handler into a preallocated slot; threads are
+ * signalled all at once, then waited for.  Threads blocking the signal do
+ * not answer and are reported without a stack.  Symbols are resolved when
+ * output, once per distinct address across all threads.
+ *
+ * GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ * @tparam AddrResolver    See \ref symbol_resolver
+ * @tparam OutputFormatter See \ref terse_call_frame_formatter, \ref fancy_call_frame_formatter
+ */
+
+template < typename CallStack
+         , typename AddrResolver
+         , typename OutputFormatter
+         >
+class thread_dump
+{
+public:
+
+    typedef CallStack                                  stack_type;
+    typedef AddrResolver                               symbol_resolver_type;
+    typedef OutputFormatter                            call_frame_formatter_type;
+    typedef thread_stack< stack_type >                 thread_stack_type;
+    typedef std::vector< thread_stack_type >           threads_type;
+    typedef typename threads_type::size_type           size_type;
+    typedef typename threads_type::const_iterator      const_iterator;
+
+    /**
+     * @return the signal used by default: SIGRTMIN+3.
+     */
+    static int default_signal()
+    {
+        return SIGRTMIN + 3;
+    }
+
+    /**
+     * @param capture    If 'true', capture the stacks of all the threads.
+     * @param signo      The signal used to interrupt the threads.
+     * @param timeout_ms How long to wait for the threads to answer.
+     */
+    explicit thread_dump(bool capture = false,
+                         int signo = default_signal(),
+                         unsigned long timeout_ms = 1000)
+        : _signo(signo)
+        , _timeout_ms(timeout_ms)
+    {
+        if (capture)
+        {
+            get_stacks();
+        }
+    }
+
+    /**
+     * Capture the stacks of all the threads.
+     * @return the number of threads that answered, 0 if the signal has a
+     * handler other than the library's.
+     */
+    size_type get_stacks()
+    {
+        typedef detail::thread_capture< stack_type >  capture_type;
+        typedef typename capture_type::slot_type      slot_type;
+
+        _threads.clear();
+        if (!capture_type::install(_signo))
+        {
+            return 0;
+        }
+
+        const std::vector<thread_id_type> tids = detail::list_threads();
+        const thread_id_type              self = detail::current_thread_id();
+
+        _threads.resize(tids.size());
+        std::vector<slot_type*> slots(tids.size(), static_cast<slot_type*>(nullptr));
+        for (size_type i = 0; i < tids.size(); ++i)
+        {
+            _threads[i].tid  = tids[i];
+            _threads[i].name = detail::thread_name(tids[i]);
+            if (tids[i] != self)
+            {
+                slots[i] = capture_type::acquire();
+            }
+        }
+
+        // Signal all, then wait for all: threads pause concurrently.
+        for (size_type i = 0; i < tids.size(); ++i)
+        {
+            if (slots[i] && !capture_type::request(*slots[i], tids[i], _signo))
+            {
+                capture_type::release(slots[i]); // Thread is gone
+                slots[i] = nullptr;
+            }
+        }
+
+        size_type answered = 0;
+        const boost::uint64_t deadline = detail::monotonic_ns() + _timeout_ms * 1000000ull;
+        for (size_type i = 0; i < tids.size(); ++i)
+        {
+            thread_stack_type& thr = _threads[i];
+            if (tids[i] == self)
+            {
+                boost::uint64_t start = detail::monotonic_ns();
+                thr.stack.get_stack();
+                thr.pause_us = static_cast<unsigned long>((detail::monotonic_ns() - start) / 1000);
+                thr.captured = true;
+            }
+            else if (slots[i] && capture_type::wait(*slots[i], deadline))
+            {
+                thr.stack    = slots[i]->stack;
+                thr.pause_us = static_cast<unsigned long>(slots[i]->pause_ns / 1000);
+                thr.captured = true;
+            }
+            if (slots[i])
+            {
+                capture_type::release(slots[i]);
+            }
+            answered += thr.captured ? 1 : 0;
+        }
+
+        return answered;
+    }
+
+    size_type size()  const noexcept { return _threads.size(); }
+    bool      empty() const noexcept { return _threads.empty(); }
+
+    const_iterator begin()  const { return _threads.begin(); }
+    const_iterator end()    const { return _threads.end(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend()   const { return end(); }
+
+    const thread_stack_type& operator [] (size_type idx) const { return _threads[idx]; }
+
+    friend inline std::ostream& operator<<(std::ostream& os,
+                                           const thread_dump& dump)
+    {
+        symbol_cache< symbol_resolver_type > cache;
+        for (const_iterator thr = dump.begin(); thr != dump.end(); ++thr)
+        {
+            os << "Thread " << std::dec << thr->tid << " \"" << thr->name << "\"";
+            if (!thr->captured)
+            {
+                os << ": no stack\n\n";
+                continue;
+            }
+            os << " paused " << std::dec << thr->pause_us << " us:\n";
+            for (typename stack_type::const_iterator frm = thr->stack.begin();
+                 frm != thr->stack.end();
+                 ++frm)
+            {
+                call_frame_formatter_type:: template print< symbol_resolver_type >(*frm, cache.resolve(frm->addr()), os);
+                os << "\n";
+            }
+            os << "\n";
+        }
+        os << std::flush;
+        return os;
+    }
+
+    std::string as_string() const
+    {
+        std::ostringstream s;
+        s << *this;
+        return s.str();
+    }
+
+private:
+
+    int              _signo;
+    unsigned long    _timeout_ms;
+    threads_type     _threads;
+}; //thread_dump
+
+
+typedef thread_dump< default_stack
+                   , default_symbol_resolver
+                   , default_call_frame_formatter >  default_thread_dump;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_THREAD_DUMP_HPP)
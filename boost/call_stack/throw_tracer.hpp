@@ -0,0 +1,262 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_THROW_TRACER_HPP)
+#define BOOST_CALL_STACK_THROW_TRACER_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/throw_hooks.hpp>
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#  include <boost/call_stack/detail/gnu/rate_limiter.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/thread/tss.hpp>
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <exception>
+#include <typeinfo>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Captures the stack where exceptions are thrown - any exception, std:: and
+ * third-party ones included - for the catch handlers to retrieve.
+ *
+ * The throw site is seen through the __cxa_throw() defined by the library:
+ * define BOOST_CALL_STACK_DEFINE_THROW_HOOK before including this header
+ * in exactly one translation unit of the program.  Without it, enable()
+ * fails.
+ *
+ * Stacks are kept by thread, for the last throws of the thread, keyed by
+ * the address of the exception object: retrieve them on the throwing thread,
+ * in the catch handler.  Exception-heavy code can capture only one throw in
+ * sample_every per thread, and at most max_per_second for the process.
+ *
+ * GCC on Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class basic_throw_tracer
+{
+public:
+
+    typedef CallStack  stack_type;
+
+    static const std::size_t ring_size = 8;   ///< throws remembered by thread
+
+    /**
+     * Start capturing throw sites.
+     * @param sample_every   Capture one throw in sample_every, by thread.
+     * @param max_per_second Capture at most this many throws per second; 0:
+     *                       no limit.
+     * @return false if the hook is not in the program.
+     */
+    static bool enable(boost::uint32_t sample_every = 1, boost::uint32_t max_per_second = 0)
+    {
+        if (!detail::throw_hooks::defined() || !detail::throw_hooks::next())
+        {
+            return false;
+        }
+        _sample_every()   = sample_every ? sample_every : 1;
+        _max_per_second() = max_per_second;
+        _enabled()        = true;
+        detail::throw_hooks::observe(&basic_throw_tracer::_on_throw);
+        return true;
+    }
+
+    /**
+     * Stop capturing throw sites.  Throws are still watched, for a stack not
+     * to be found for a later exception object at the same address.
+     */
+    static void disable()
+    {
+        _enabled() = false;
+    }
+
+    static bool enabled()
+    {
+        return _enabled().load();
+    }
+
+    /**
+     * Stack where the exception object was thrown from, by this thread.
+     * Catch the exception by its most derived type, or use current(): the
+     * address of a base class subobject might differ.
+     *
+     * @return false if not captured.
+     */
+    static bool where(const void* object, stack_type& stack)
+    {
+        ring_type* ring = _ring().get();
+        if (!ring || !object)
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < ring_size; ++i)
+        {
+            const entry_type& entry = ring->entries[(ring->next + ring_size - 1 - i) % ring_size];
+            if (entry.object == object)
+            {
+                stack = entry.stack;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Stack where the exception being handled was thrown from.
+     * @return false if none is handled, or not captured.
+     */
+    static bool current(stack_type& stack)
+    {
+        // libstdc++: an exception_ptr holds the address of the object
+        BOOST_STATIC_ASSERT(sizeof(std::exception_ptr) == sizeof(void*));
+        std::exception_ptr ptr = std::current_exception();
+        void* object = nullptr;
+        std::memcpy(&object, &ptr, sizeof(object));
+        return where(object, stack);
+    }
+
+    /**
+     * @return the number of throws seen, and of those captured.
+     */
+    static boost::uint64_t throws()   { return _throws().load(); }
+    static boost::uint64_t captured() { return _captured().load(); }
+
+private:
+
+    struct entry_type
+    {
+        const void*  object;
+        stack_type   stack;
+    };
+
+    struct ring_type
+    {
+        entry_type       entries[ring_size];
+        std::size_t      next;
+        boost::uint32_t  countdown;   ///< throws until the next sample
+
+        ring_type() : next(0), countdown(0)
+        {
+            for (std::size_t i = 0; i < ring_size; ++i)
+            {
+                entries[i].object = nullptr;
+            }
+        }
+    };
+
+    static boost::thread_specific_ptr< ring_type >& _ring()
+    {
+        static boost::thread_specific_ptr< ring_type > ring;
+        return ring;
+    }
+
+    static void _on_throw(void* object, std::type_info*)
+    {
+        ring_type* ring = _ring().get();
+        if (ring)
+        {
+            // Exception objects are freed once handled: addresses get reused
+            for (std::size_t i = 0; i < ring_size; ++i)
+            {
+                if (ring->entries[i].object == object)
+                {
+                    ring->entries[i].object = nullptr;
+                }
+            }
+        }
+        if (!_enabled().load(boost::memory_order_relaxed))
+        {
+            return;
+        }
+        ++_throws();
+
+        if (!ring)
+        {
+            ring = new ring_type();
+            _ring().reset(ring);
+        }
+        if (ring->countdown > 1)
+        {
+            --ring->countdown;
+            return;
+        }
+        ring->countdown = _sample_every().load(boost::memory_order_relaxed);
+        if (!_admit())
+        {
+            return;
+        }
+
+        entry_type& entry = ring->entries[ring->next];
+        ring->next = (ring->next + 1) % ring_size;
+        entry.object = object;
+        entry.stack.get_stack();
+        ++_captured();
+    }
+
+    static bool _admit()
+    {
+        static detail::rate_limiter limiter;
+        return limiter.admit(_max_per_second().load(boost::memory_order_relaxed));
+    }
+
+    static boost::atomic<bool>& _enabled()
+    {
+        static boost::atomic<bool> enabled(false);
+        return enabled;
+    }
+
+    static boost::atomic<boost::uint32_t>& _sample_every()
+    {
+        static boost::atomic<boost::uint32_t> every(1);
+        return every;
+    }
+
+    static boost::atomic<boost::uint32_t>& _max_per_second()
+    {
+        static boost::atomic<boost::uint32_t> max(0);
+        return max;
+    }
+
+    static boost::atomic<boost::uint64_t>& _throws()
+    {
+        static boost::atomic<boost::uint64_t> throws(0);
+        return throws;
+    }
+
+    static boost::atomic<boost::uint64_t>& _captured()
+    {
+        static boost::atomic<boost::uint64_t> captured(0);
+        return captured;
+    }
+}; //basic_throw_tracer
+
+
+typedef basic_throw_tracer< default_stack >  default_throw_tracer;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_THROW_TRACER_HPP)
@@ -0,0 +1,381 @@
+/*
+ *  Copyright 2013 Aurelian Melinte.
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+#if !defined(BOOST_CALL_STACK_TRACE_HPP)
+#define BOOST_CALL_STACK_TRACE_HPP
+
+#if defined(_MSC_VER) && _MSC_VER >= 1200
+#  pragma once
+#endif
+
+#include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/stack_depot.hpp>
+#include <boost/call_stack/detail/thread_buffers.hpp>
+
+#if defined(__GNUG__) && defined(__linux__)
+#  include <boost/call_stack/detail/gnu/threads.hpp>
+#else
+#  error "Unsupported platform."
+#endif
+
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace boost { namespace call_stack {
+
+/**
+ * Records a timeline of events - begin/end of a duration, or instants -
+ * each tagged with the call stack where it was recorded, and writes it in
+ * the Chrome trace-event JSON format (chrome://tracing, Perfetto UI,
+ * speedscope).
+ *
+ * Events are appended to a buffer of the recording thread: threads do not
+ * contend.  Stacks are stored once in a \ref stack_depot and events only
+ * keep their id; symbols are resolved when the trace is written, once per
+ * distinct address.  A buffer holds at most the capacity given at
+ * construction; further events of the thread are dropped and counted.
+ *
+ * Event names must outlive the recorder (e.g. string literals).  GCC on
+ * Linux only.
+ *
+ * @tparam CallStack       See \ref call_stack
+ */
+template < typename CallStack >
+class trace_recorder : private boost::noncopyable
+{
+public:
+
+    typedef CallStack                         stack_type;
+    typedef stack_depot< stack_type >         depot_type;
+    typedef typename depot_type::id_type      stack_id_type;
+
+    enum phase_type
+    {
+        begin_phase   = 'B',
+        end_phase     = 'E',
+        instant_phase = 'i'
+    };
+
+    struct event_type
+    {
+        boost::uint64_t  ts_ns;      ///< monotonic clock
+        const char*      name;
+        stack_id_type    stack_id;   ///< 0: no stack
+        char             phase;
+    };
+
+    /**
+     * @param capacity Maximum number of events buffered per thread.
+     */
+    explicit trace_recorder(std::size_t capacity = 1 << 16)
+        : _capacity(capacity)
+        , _dropped(0)
+        , _buffers(capacity)
+    {}
+
+    /**
+     * Start of a duration, on the current thread.
+     */
+    void begin(const char* name, bool capture = true)
+    {
+        _record(name, begin_phase, capture);
+    }
+
+    /**
+     * End of the latest duration begun on the current thread.
+     */
+    void end(const char* name = "", bool capture = false)
+    {
+        _record(name, end_phase, capture);
+    }
+
+    void instant(const char* name, bool capture = true)
+    {
+        _record(name, instant_phase, capture);
+    }
+
+    /**
+     * @return the number of events buffered.
+     */
+    std::size_t size() const
+    {
+        const buffers_type buffers = _buffers.all();
+        std::size_t ret = 0;
+        for (std::size_t i = 0; i < buffers.size(); ++i)
+        {
+            boost::mutex::scoped_lock buf_lock(buffers[i]->mutex);
+            ret += buffers[i]->events.size();
+        }
+        return ret;
+    }
+
+    boost::uint64_t dropped() const noexcept { return _dropped.load(); }
+
+    depot_type&       depot()       noexcept { return _depot; }
+    const depot_type& depot() const noexcept { return _depot; }
+
+    /**
+     * Forget the events buffered so far; the stacks are kept.
+     */
+    void clear()
+    {
+        const buffers_type buffers = _buffers.all();
+        for (std::size_t i = 0; i < buffers.size(); ++i)
+        {
+            boost::mutex::scoped_lock buf_lock(buffers[i]->mutex);
+            buffers[i]->events.clear();
+        }
+        _dropped = 0;
+    }
+
+    /**
+     * Write the events in Chrome trace-event JSON format.  Each stack is
+     * written as a chain of "stackFrames" entries (shared by stacks with
+     * a common root) referred to by the "sf" of its events.
+     *
+     * @tparam AddrResolver    See \ref symbol_resolver
+     */
+    template < typename AddrResolver >
+    void write_json(std::ostream& os) const
+    {
+        typedef std::pair< std::size_t, address_type >                  frame_key;     // parent, address
+        typedef boost::unordered_map< frame_key, std::size_t
+                                    , boost::hash<frame_key> >          frames_type;
+        typedef boost::unordered_map< stack_id_type, std::size_t >      leaves_type;
+
+        frames_type                  frames;
+        std::vector<frame_key>       frame_list;
+        leaves_type                  leaves;
+        symbol_cache< AddrResolver > symbols;
+        std::string                  line;
+        const int                    pid = static_cast<int>(::getpid());
+
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+
+        const buffers_type buffers = _buffers.all();
+        for (std::size_t b = 0; b < buffers.size(); ++b)
+        {
+            const buffer_type& buf = *buffers[b];
+            boost::mutex::scoped_lock buf_lock(buf.mutex);
+            for (std::size_t e = 0; e < buf.events.size(); ++e)
+            {
+                const event_type& ev = buf.events[e];
+
+                std::size_t leaf = 0;
+                if (ev.stack_id != depot_type::null_id)
+                {
+                    typename leaves_type::const_iterator lit = leaves.find(ev.stack_id);
+                    if (lit == leaves.end())
+                    {
+                        const stack_type& stack = _depot.get(ev.stack_id);
+                        for (typename stack_type::size_type i = stack.depth(); i-- > 0; )
+                        {
+                            frame_key key(leaf, stack[i].addr());
+                            typename frames_type::const_iterator fit = frames.find(key);
+                            if (fit == frames.end())
+                            {
+                                frame_list.push_back(key);
+                                fit = frames.insert(typename frames_type::value_type(key, frame_list.size())).first;
+                            }
+                            leaf = fit->second;
+                        }
+                        lit = leaves.insert(typename leaves_type::value_type(ev.stack_id, leaf)).first;
+                    }
+                    leaf = lit->second;
+                }
+
+                char ts[64];
+                std::snprintf(ts, sizeof(ts), "%llu.%03u",
+                              static_cast<unsigned long long>(ev.ts_ns / 1000),
+                              static_cast<unsigned int>(ev.ts_ns % 1000));
+
+                line.clear();
+                line += first ? "\n{\"name\":\"" : ",\n{\"name\":\"";
+                _escape(line, ev.name);
+                line += "\",\"ph\":\"";
+                line += ev.phase;
+                line += "\",\"ts\":";
+                line += ts;
+                line += ",\"pid\":";
+                _append_dec(line, static_cast<boost::uint64_t>(pid));
+                line += ",\"tid\":";
+                _append_dec(line, static_cast<boost::uint64_t>(buf.tid));
+                if (ev.phase == instant_phase)
+                {
+                    line += ",\"s\":\"t\"";
+                }
+                if (leaf)
+                {
+                    line += ",\"sf\":\"";
+                    _append_dec(line, leaf);
+                    line += "\",\"args\":{\"stack_id\":";
+                    _append_dec(line, ev.stack_id);
+                    line += "}";
+                }
+                line += "}";
+                os.write(line.data(), static_cast<std::streamsize>(line.size()));
+                first = false;
+            }
+        }
+
+        os << "\n],\"stackFrames\":{";
+        for (std::size_t f = 0; f < frame_list.size(); ++f)
+        {
+            const AddrResolver& sym = symbols.resolve(frame_list[f].second);
+            line.clear();
+            line += f ? ",\n\"" : "\n\"";
+            _append_dec(line, f + 1);
+            line += "\":{\"category\":\"";
+            const char* binary = sym.binary_file();
+            const char* slash  = std::strrchr(binary, '/');
+            _escape(line, slash ? slash + 1 : binary);
+            line += "\",\"name\":\"";
+            _escape(line, sym.demangled_name());
+            line += "\"";
+            if (frame_list[f].first)
+            {
+                line += ",\"parent\":\"";
+                _append_dec(line, frame_list[f].first);
+                line += "\"";
+            }
+            line += "}";
+            os.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+        os << "\n}}\n" << std::flush;
+    }
+
+private:
+
+    struct buffer_type
+    {
+        mutable boost::mutex     mutex;   ///< uncontended but when written out
+        detail::thread_id_type   tid;
+        std::vector<event_type>  events;
+
+        explicit buffer_type(std::size_t capacity)
+            : tid(detail::current_thread_id())
+        {
+            events.reserve((std::min)(capacity, static_cast<std::size_t>(1024)));
+        }
+    };
+
+    typedef std::vector< boost::shared_ptr<buffer_type> >  buffers_type;
+
+    void _record(const char* name, phase_type phase, bool capture)
+    {
+        event_type ev;
+        ev.ts_ns    = detail::monotonic_ns();
+        ev.name     = name ? name : "";
+        ev.phase    = static_cast<char>(phase);
+        ev.stack_id = capture ? _depot.capture() : depot_type::null_id;
+
+        buffer_type& buf = _buffers.local();
+        boost::mutex::scoped_lock lock(buf.mutex);
+        if (buf.events.size() < _capacity)
+        {
+            buf.events.push_back(ev);
+        }
+        else
+        {
+            ++_dropped;
+        }
+    }
+
+    static void _escape(std::string& out, const char* str)
+    {
+        for (; *str; ++str)
+        {
+            const unsigned char c = static_cast<unsigned char>(*str);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += static_cast<char>(c);
+            }
+            else if (c < 0x20)
+            {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            }
+            else
+            {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+
+    static void _append_dec(std::string& out, boost::uint64_t value)
+    {
+        fixed_output_buffer<24> digits;
+        digits.append_dec(value);
+        out.append(digits.c_str(), digits.size());
+    }
+
+private:
+
+    const std::size_t                     _capacity;
+    boost::atomic<boost::uint64_t>        _dropped;
+    depot_type                            _depot;
+    detail::thread_buffers<buffer_type>   _buffers;
+}; //trace_recorder
+
+
+/**
+ * Records a duration for the life of the object: begin() at construction,
+ * end() at destruction.
+ */
+template < typename CallStack >
+class trace_scope : private boost::noncopyable
+{
+public:
+
+    trace_scope(trace_recorder< CallStack >& recorder, const char* name, bool capture = true)
+        : _recorder(recorder)
+        , _name(name)
+    {
+        _recorder.begin(_name, capture);
+    }
+
+    ~trace_scope()
+    {
+        _recorder.end(_name, false);
+    }
+
+private:
+
+    trace_recorder< CallStack >&  _recorder;
+    const char*                   _name;
+}; //trace_scope
+
+
+typedef trace_recorder< default_stack >  default_trace_recorder;
+typedef trace_scope< default_stack >     default_trace_scope;
+
+
+}} //namespace boost::call_stack
+
+
+#endif //#if !defined(BOOST_CALL_STACK_TRACE_HPP)
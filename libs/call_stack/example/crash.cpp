@@ -0,0 +1,53 @@
+/*
+ *  Copyright 2013 Aurelian Melinte. 
+ *
+ *  Use, modification and distribution are subject to the Boost Software License,
+ *  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt).
+ */
+
+
+//[crash
+/*`
+[h4 A crash handler example]
+Install a handler for fatal signals early in main().  When the program crashes, 
+the call stack of the crashing thread is written to the given file descriptor.
+The handler does not allocate memory, does not take locks and does not resolve
+symbols: frames are written as raw addresses plus the binary they belong to and
+the offset within it.  Use addr2line(1) to resolve the offsets offline.
+*/
+
+#include <boost/call_stack/crash_handler.hpp>
+
+void func2(volatile int* p)
+{
+    *p = 42;
+}
+
+void func1()
+{
+    func2(0);
+}
+
+int main()
+{
+    boost::call_stack::install_crash_handler(STDERR_FILENO);
+    func1();
+    return 0;
+}
+
+/*`
+Possible output on a Linux platform:
+``
+*** Caught signal 11 (SIGSEGV), address 0, pid 2625, tid 2625:
+#0  0x560a9ead310f in /home/amelinte/work/boost/call_stack/bin/crash+0x310f
+#1  0x560a9ead3130 in /home/amelinte/work/boost/call_stack/bin/crash+0x3130
+#2  0x560a9ead3157 in /home/amelinte/work/boost/call_stack/bin/crash+0x3157
+#3  0x7f1bd1a2a24a in /lib/x86_64-linux-gnu/libc.so.6+0x2724a
+#4  0x7f1bd1a2a305 in /lib/x86_64-linux-gnu/libc.so.6+0x27305
+#5  0x560a9ead3021 in /home/amelinte/work/boost/call_stack/bin/crash+0x3021
+*** End of stack
+Segmentation fault
+``
+*/
+//]
@@ -10,16 +10,48 @@
 #include <boost/config.hpp>
 
 #include <boost/call_stack/call_stack.hpp>
+#include <boost/call_stack/crash_handler.hpp>
+#include <boost/call_stack/thread_dump.hpp>
+#include <boost/call_stack/profiler.hpp>
+#include <boost/call_stack/folded.hpp>
+#include <boost/call_stack/pprof.hpp>
+#include <boost/call_stack/trace.hpp>
+#define BOOST_CALL_STACK_DEFINE_MALLOC_HOOKS
+#include <boost/call_stack/leak_checker.hpp>
+#include <boost/call_stack/heap_profiler.hpp>
+#include <boost/call_stack/contention_profiler.hpp>
+#define BOOST_CALL_STACK_DEFINE_THROW_HOOK
+#include <boost/call_stack/throw_tracer.hpp>
+#include <boost/call_stack/flight_recorder.hpp>
+#include <boost/call_stack/sampled_capture.hpp>
+#include <boost/call_stack/stack_histogram.hpp>
+#include <boost/call_stack/call_graph.hpp>
+#include <boost/call_stack/latency_guard.hpp>
+#include <boost/call_stack/stall_watchdog.hpp>
+#include <boost/call_stack/lock_order.hpp>
+#include <boost/call_stack/instance_tracker.hpp>
+#define BOOST_CALL_STACK_DEFINE_RESOURCE_HOOKS
+#include <boost/call_stack/resource_tracker.hpp>
+#define BOOST_CALL_STACK_DEFINE_SHADOW_STACK_HOOKS
+#include <boost/call_stack/shadow_stack.hpp>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/static_assert.hpp>
 #include <boost/utility.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
 
 #include <iostream>
 #include <functional>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <ucontext.h>
+
 
 
 static const std::size_t test_max_stack_size = 39;  
@@ -36,6 +68,10 @@ typedef boost::call_stack::call_stack_info< test_stack_type
                                           , boost::call_stack::extended_symbol_resolver
                                           , boost::call_stack::fancy_call_frame_formatter
                                           >     test_extended_call_stack_info_type;
+typedef boost::call_stack::resolved_call_stack_info< test_stack_type
+                                                   , boost::call_stack::extended_symbol_resolver
+                                                   , boost::call_stack::fancy_call_frame_formatter
+                                                   >     test_resolved_call_stack_info_type;
 
 static test_stack_type sg_astack;
 
@@ -213,6 +249,1487 @@ void test_call_stack_info()
 }
 
 
+int recurse_and_resolve(int depth, test_stack_type& out)
+{
+    if (depth > 0) {
+        return recurse_and_resolve(depth - 1, out) + 1;
+    }
+    out.get_stack();
+    return 0;
+}
+
+void test_resolved_call_stack_info()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_stack_type s1(true);
+    test_resolved_call_stack_info_type r1(s1);
+    test_extended_call_stack_info_type i1(s1);
+    BOOST_CHECK( r1.depth() == s1.depth() );
+    BOOST_CHECK( r1.resolved_count() <= s1.depth() && r1.resolved_count() > 0 );
+
+    // Byte-identical to the lazily resolved output
+    BOOST_CHECK( r1.as_string() == i1.as_string() );
+    std::cout << "\nr1: \n" << r1 << std::endl;
+
+    std::size_t n = 0;
+    for (test_resolved_call_stack_info_type::const_iterator it = r1.begin(); it != r1.end(); ++it, ++n) {
+        BOOST_CHECK( it->frame() == s1[n] );
+        BOOST_CHECK( it->symbol().addr() == s1[n].addr() );
+    }
+    BOOST_CHECK( n == s1.depth() );
+
+    // Copies share the resolved information
+    test_resolved_call_stack_info_type r2(r1);
+    BOOST_CHECK( r2 == r1 );
+    BOOST_CHECK( &r2.symbol(0) == &r1.symbol(0) );
+
+    test_resolved_call_stack_info_type r3;
+    BOOST_CHECK( r3.empty() && r3 != r1 );
+    std::swap(r2, r3);
+    BOOST_CHECK( r2.empty() && r3 == r1 );
+
+    // Recursion: the same return address is resolved once
+    test_stack_type s2;
+    recurse_and_resolve(5, s2);
+    test_resolved_call_stack_info_type r4(s2);
+    BOOST_CHECK( r4.resolved_count() < r4.depth() );
+    BOOST_CHECK( r4.as_string() == test_extended_call_stack_info_type(s2).as_string() );
+}
+
+template < typename CallStackInfo >
+void check_output_buffer(const test_stack_type& stk)
+{
+    CallStackInfo info(stk);
+    boost::call_stack::fixed_output_buffer<16 * 1024> buf;
+    info.format(buf);
+    BOOST_CHECK( !buf.truncated() );
+    BOOST_CHECK( info.as_string() == buf.c_str() );
+    BOOST_CHECK( info.as_string().size() == buf.size() );
+}
+
+void test_output_buffer()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    char raw[8];
+    boost::call_stack::output_buffer out(raw, sizeof(raw));
+    BOOST_CHECK( out.size() == 0 && std::string(out.c_str()).empty() );
+    out.append_dec(0u).append(' ').append_hex(255);
+    BOOST_CHECK( std::string(out.c_str()) == "0 ff" && !out.truncated() );
+    out.append("truncated");
+    BOOST_CHECK( out.truncated() && out.size() == sizeof(raw) - 1 && std::string(out.c_str()) == "0 fftru" );
+    out.clear();
+    BOOST_CHECK( out.size() == 0 && !out.truncated() );
+
+    boost::call_stack::fixed_output_buffer<64> hex;
+    hex.append_hex(-48L);
+    std::ostringstream osshex;
+    osshex << std::hex << -48L;
+    BOOST_CHECK( osshex.str() == hex.c_str() );
+
+    // Same bytes as the std::ostream formatters
+    test_stack_type here(true);
+    check_output_buffer<test_null_call_stack_info_type>(here);
+    check_output_buffer<test_basic_call_stack_info_type>(here);
+    check_output_buffer<test_extended_call_stack_info_type>(here);
+    check_output_buffer<test_resolved_call_stack_info_type>(here);
+    check_output_buffer< boost::call_stack::call_stack_info< test_stack_type
+                                                           , boost::call_stack::basic_symbol_resolver
+                                                           , boost::call_stack::fancy_call_frame_formatter
+                                                           > >(here);
+
+    boost::call_stack::symbol_info< boost::call_stack::basic_symbol_resolver,
+                                    boost::call_stack::terse_symbol_formatter > sym(here[0].addr());
+    boost::call_stack::fixed_output_buffer<1024> symbuf;
+    BOOST_CHECK( sym.as_string() == sym.format(symbuf).c_str() );
+    boost::call_stack::symbol_info< boost::call_stack::basic_symbol_resolver,
+                                    boost::call_stack::terse_symbol_formatter > nullsym;
+    symbuf.clear();
+    BOOST_CHECK( nullsym.as_string() == nullsym.format(symbuf).c_str() );
+}
+
+__attribute__((noinline)) void crash_here(volatile int* p)
+{
+    *p = 42;
+}
+
+void test_crash_handler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    int fds[2];
+    BOOST_REQUIRE( ::pipe(fds) == 0 );
+
+    pid_t pid = ::fork();
+    BOOST_REQUIRE( pid >= 0 );
+    if (pid == 0) {
+        ::close(fds[0]);
+        ::signal(SIGSEGV, SIG_DFL); // Not the test framework's handler
+        boost::call_stack::install_crash_handler(fds[1]);
+        crash_here(nullptr);
+        ::_exit(0);
+    }
+
+    ::close(fds[1]);
+    std::string out;
+    char buf[1024];
+    ssize_t len;
+    while ((len = ::read(fds[0], buf, sizeof(buf))) > 0) {
+        out.append(buf, len);
+    }
+    ::close(fds[0]);
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    std::cout << out << std::endl;
+    BOOST_CHECK( WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV );
+    BOOST_CHECK( out.find("(SIGSEGV)") != std::string::npos );
+    BOOST_CHECK( out.find("*** End of stack") != std::string::npos );
+
+    // Same address space as the child: frame #0 is the faulting instruction
+    std::string::size_type at = out.find("#0  0x");
+    BOOST_REQUIRE( at != std::string::npos );
+    std::istringstream iss(out.substr(at + 4));
+    void* addr = nullptr;
+    iss >> addr;
+    boost::call_stack::symbol_resolver< boost::call_stack::basic_symbol_resolver > sym(addr);
+    BOOST_CHECK( std::string(sym.demangled_name()).find("crash_here") != std::string::npos );
+    BOOST_CHECK( out.find("+0x", at) != std::string::npos );
+}
+
+static test_stack_type sg_signal_stack;
+static test_stack_type sg_handler_stack;
+static boost::call_stack::address_type sg_signal_pc = boost::call_stack::null_address;
+
+void on_test_signal(int, siginfo_t*, void* context)
+{
+    const boost::call_stack::context_type& ctx = *static_cast<const boost::call_stack::context_type*>(context);
+    sg_signal_pc = boost::call_stack::detail::get_context_pc(ctx);
+    sg_signal_stack.get_stack(ctx);
+    sg_handler_stack.get_stack();
+}
+
+__attribute__((noinline)) void signal_myself()
+{
+    ::raise(SIGUSR1);
+}
+
+void test_context_stack()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    struct sigaction sa, old;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_test_signal;
+    sa.sa_flags = SA_SIGINFO;
+    ::sigemptyset(&sa.sa_mask);
+    BOOST_REQUIRE( ::sigaction(SIGUSR1, &sa, &old) == 0 );
+    signal_myself();
+    ::sigaction(SIGUSR1, &old, nullptr);
+
+    std::cout << "\nfrom context:\n" << test_basic_call_stack_info_type(sg_signal_stack) << std::endl;
+    BOOST_REQUIRE( sg_signal_stack.depth() > 0 );
+    BOOST_CHECK( sg_signal_stack[0].addr() == sg_signal_pc );
+    BOOST_CHECK( sg_signal_stack.depth() < sg_handler_stack.depth() );
+
+    std::string ctxstr     = test_basic_call_stack_info_type(sg_signal_stack).as_string();
+    std::string handlerstr = test_basic_call_stack_info_type(sg_handler_stack).as_string();
+    BOOST_CHECK( ctxstr.find("on_test_signal") == std::string::npos );
+    BOOST_CHECK( handlerstr.find("on_test_signal") != std::string::npos );
+    BOOST_CHECK( ctxstr.find("signal_myself") != std::string::npos );
+
+    // Not the context of the signal being handled: walks frame pointers
+    boost::call_stack::context_type here;
+    ::getcontext(&here);
+    test_stack_type s1;
+    s1.get_stack(here);
+    BOOST_CHECK( s1.depth() > 0 );
+    BOOST_CHECK( s1.depth() == 0 || s1[0].addr() == boost::call_stack::detail::get_context_pc(here) );
+}
+
+static boost::atomic<int> sg_parked(0);
+static boost::atomic<bool> sg_unpark(false);
+
+__attribute__((noinline)) void parked_thread()
+{
+    ++sg_parked;
+    while (!sg_unpark) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+void test_thread_dump()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::thread_dump< test_stack_type
+                                          , boost::call_stack::basic_symbol_resolver
+                                          , boost::call_stack::terse_call_frame_formatter
+                                          >  test_thread_dump_type;
+
+    static const int parked = 3;
+    boost::thread_group threads;
+    for (int i = 0; i < parked; ++i) {
+        threads.create_thread(parked_thread);
+    }
+    while (sg_parked < parked) {
+        boost::this_thread::yield();
+    }
+
+    test_thread_dump_type dump(true);
+    std::cout << dump << std::endl;
+    BOOST_CHECK( dump.size() >= parked + 1 );
+
+    int found = 0;
+    for (test_thread_dump_type::const_iterator it = dump.begin(); it != dump.end(); ++it) {
+        BOOST_CHECK( it->captured );
+        BOOST_CHECK( it->stack.depth() > 0 );
+        std::string stk = boost::call_stack::call_stack_info< test_stack_type
+                                                            , boost::call_stack::basic_symbol_resolver
+                                                            , boost::call_stack::terse_call_frame_formatter
+                                                            >(it->stack).as_string();
+        found += (stk.find("parked_thread") != std::string::npos) ? 1 : 0;
+    }
+    BOOST_CHECK( found == parked );
+    BOOST_CHECK( dump.as_string().find("test_thread_dump") != std::string::npos );
+
+    // Slots are recycled
+    BOOST_CHECK( dump.get_stacks() == dump.size() );
+
+    // A signal with a handler of its own is left alone
+    const int foreign_signo = SIGRTMIN + 6;
+    struct sigaction sa, old, cur;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_test_signal;
+    sa.sa_flags = SA_SIGINFO;
+    ::sigemptyset(&sa.sa_mask);
+    BOOST_REQUIRE( ::sigaction(foreign_signo, &sa, &old) == 0 );
+    test_thread_dump_type foreign(false, foreign_signo);
+    BOOST_CHECK( foreign.get_stacks() == 0 );
+    BOOST_CHECK( ::sigaction(foreign_signo, nullptr, &cur) == 0 && cur.sa_sigaction == on_test_signal );
+    ::sigaction(foreign_signo, &old, nullptr);
+
+    sg_unpark = true;
+    threads.join_all();
+}
+
+__attribute__((noinline)) double spin_cpu(boost::uint64_t ms)
+{
+    volatile double x = 0;
+    const boost::uint64_t until = boost::call_stack::detail::monotonic_ns() + ms * 1000000ull;
+    while (boost::call_stack::detail::monotonic_ns() < until) {
+        for (int i = 0; i < 1000; ++i) {
+            x = x + i * 0.5;
+        }
+    }
+    return x;
+}
+
+__attribute__((noinline)) void capture_here(test_stack_type& stk)
+{
+    stk.get_stack();
+    asm("");
+}
+
+__attribute__((noinline)) void capture_deeper(test_stack_type& stk, int levels)
+{
+    if (levels) {
+        capture_deeper(stk, levels - 1);
+    } else {
+        capture_here(stk);
+    }
+    asm("");
+}
+
+void test_cpu_profiler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::cpu_profiler< test_stack_type >  test_profiler_type;
+
+    test_profiler_type prof(1000);
+    BOOST_CHECK( !prof.running() );
+    BOOST_CHECK( prof.start() );
+    BOOST_CHECK( prof.running() );
+    spin_cpu(300);
+    prof.stop();
+    BOOST_CHECK( !prof.running() );
+
+    test_profiler_type::profile_type profile = prof.profile();
+    std::cout << "samples: " << prof.samples() << ", dropped: " << prof.dropped()
+              << ", stacks: " << profile.size() << std::endl;
+    BOOST_CHECK( prof.samples() > 0 );
+    BOOST_CHECK( profile.total().count == prof.samples() );
+    BOOST_CHECK( profile.total().weight == prof.samples() * 1000000ull );
+
+    boost::uint64_t spinning = 0;
+    for (test_profiler_type::profile_type::const_iterator it = profile.begin(); it != profile.end(); ++it) {
+        std::string stk = boost::call_stack::call_stack_info< test_stack_type
+                                                            , boost::call_stack::basic_symbol_resolver
+                                                            , boost::call_stack::terse_call_frame_formatter
+                                                            >(it->first).as_string();
+        spinning += (stk.find("spin_cpu") != std::string::npos) ? it->second.count : 0;
+    }
+    BOOST_CHECK( spinning > 0 );
+    BOOST_CHECK( spinning * 2 > prof.samples() );
+
+    // Restartable; take_profile() empties
+    BOOST_CHECK( prof.take_profile().size() == profile.size() );
+    BOOST_CHECK( prof.profile().empty() );
+    BOOST_CHECK( prof.start() );
+    spin_cpu(50);
+    prof.stop();
+
+    // A signal with a handler of its own is left alone
+    const int foreign_signo = SIGRTMIN + 6;
+    struct sigaction sa, old, cur;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_test_signal;
+    sa.sa_flags = SA_SIGINFO;
+    ::sigemptyset(&sa.sa_mask);
+    BOOST_REQUIRE( ::sigaction(foreign_signo, &sa, &old) == 0 );
+    test_profiler_type foreign(1000, foreign_signo);
+    BOOST_CHECK( !foreign.start() );
+    BOOST_CHECK( ::sigaction(foreign_signo, nullptr, &cur) == 0 && cur.sa_sigaction == on_test_signal );
+    ::sigaction(foreign_signo, &old, nullptr);
+
+    // Sorted by decreasing count, or weight
+    test_profiler_type::profile_type byhand;
+    test_stack_type here(true);
+    byhand.add(here, 1, 30);
+    byhand.add(test_stack_type(), 3, 10);
+    std::vector<test_profiler_type::profile_type::entry_type> sorted = byhand.sorted();
+    BOOST_CHECK( sorted.size() == 2 && sorted[0].second.count == 3 && sorted[1].first == here );
+    sorted = byhand.sorted(true);
+    BOOST_CHECK( sorted.size() == 2 && sorted[0].first == here && sorted[0].second.weight == 30 );
+
+    // A stack captured again into the same object, as the sampler does,
+    // keeps a deeper tail past its depth: it is the same stack still
+    test_stack_type reused, fresh;
+    capture_deeper(reused, 5);
+    for (volatile int i = 0; i < 2; ++i) { // One call site: not unrolled
+        capture_here(i ? fresh : reused);
+    }
+    BOOST_CHECK( reused == fresh );
+    BOOST_CHECK( !(reused != fresh) );
+    test_profiler_type::profile_type once;
+    once.add(reused);
+    once.add(fresh);
+    BOOST_CHECK( once.size() == 1 );
+}
+
+static boost::mutex              sg_blocked_mutex;
+static boost::condition_variable sg_blocked_cond;
+static bool                      sg_blocked_release = false;
+
+__attribute__((noinline)) void blocked_thread()
+{
+    boost::mutex::scoped_lock lock(sg_blocked_mutex);
+    while (!sg_blocked_release) {
+        sg_blocked_cond.wait(lock);
+    }
+}
+
+template < typename Profile >
+boost::uint64_t weight_of(const Profile& profile, const char* function)
+{
+    boost::uint64_t weight = 0;
+    for (typename Profile::const_iterator it = profile.begin(); it != profile.end(); ++it) {
+        std::string stk = boost::call_stack::call_stack_info< test_stack_type
+                                                            , boost::call_stack::basic_symbol_resolver
+                                                            , boost::call_stack::terse_call_frame_formatter
+                                                            >(it->first).as_string();
+        weight += (stk.find(function) != std::string::npos) ? it->second.weight : 0;
+    }
+    return weight;
+}
+
+void test_wall_profiler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::wall_profiler< test_stack_type >  test_profiler_type;
+
+    boost::thread blocked(blocked_thread);
+
+    test_profiler_type prof(200);
+    BOOST_CHECK( prof.start() );
+    spin_cpu(300);
+    prof.stop();
+
+    test_profiler_type::profile_type on_cpu  = prof.profile();
+    test_profiler_type::profile_type off_cpu = prof.off_cpu_profile();
+    std::cout << "samples: " << prof.samples()
+              << ", on-CPU ms: " << on_cpu.total().weight / 1000000
+              << ", off-CPU ms: " << off_cpu.total().weight / 1000000 << std::endl;
+    BOOST_CHECK( prof.samples() > 0 );
+    BOOST_CHECK( on_cpu.total().count + off_cpu.total().count == prof.samples() );
+
+    // The spinning thread is on CPU, the blocked one is not
+    const boost::uint64_t spinning = weight_of(on_cpu, "spin_cpu");
+    const boost::uint64_t waiting  = weight_of(off_cpu, "blocked_thread");
+    BOOST_CHECK( spinning > 100 * 1000000ull );
+    BOOST_CHECK( waiting  > 100 * 1000000ull );
+    BOOST_CHECK( weight_of(on_cpu, "blocked_thread") < waiting / 10 );
+
+    {
+        boost::mutex::scoped_lock lock(sg_blocked_mutex);
+        sg_blocked_release = true;
+        sg_blocked_cond.notify_all();
+    }
+    blocked.join();
+}
+
+void test_perf_profiler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::perf_profiler< test_stack_type >  test_profiler_type;
+
+    // Kernel call chains are assigned into reused stacks: no leftover tail
+    boost::call_stack::address_type chain[4];
+    for (std::size_t i = 0; i < 4; ++i) {
+        chain[i] = reinterpret_cast<boost::call_stack::address_type>(0x1000 + i);
+    }
+    test_stack_type reused, fresh;
+    reused.assign(chain, 4);
+    reused.assign(chain, 2);
+    fresh.assign(chain, 2);
+    BOOST_CHECK( reused == fresh );
+    BOOST_CHECK( reused[2].addr() == boost::call_stack::null_address );
+
+    test_profiler_type prof(1000);
+    if (!prof.start()) {
+        std::cout << "perf events not available" << std::endl;
+        BOOST_CHECK( !prof.running() );
+        return;
+    }
+    spin_cpu(300);
+    prof.stop();
+
+    test_profiler_type::profile_type profile = prof.profile();
+    std::cout << "samples: " << prof.samples() << ", dropped: " << prof.dropped()
+              << ", stacks: " << profile.size() << std::endl;
+    BOOST_CHECK( prof.samples() > 0 );
+    BOOST_CHECK( profile.total().count == prof.samples() );
+    BOOST_CHECK( prof.off_cpu_profile().empty() );
+
+    const boost::uint64_t spinning = weight_of(profile, "spin_cpu");
+    BOOST_CHECK( spinning > 0 );
+    BOOST_CHECK( spinning * 2 > profile.total().weight );
+}
+
+void test_folded_stack_writer()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_stack_type s1, s2;
+    recurse_and_resolve(3, s1);
+    recurse_and_resolve(5, s2);
+
+    boost::call_stack::stack_profile< test_stack_type > profile;
+    profile.add(s1, 7, 700);
+    profile.add(s2, 3, 300);
+    profile.add(s1);
+    profile.add(test_stack_type());    // Skipped
+
+    std::ostringstream os;
+    boost::call_stack::folded_stack_writer< boost::call_stack::basic_symbol_resolver > writer(os);
+    writer.write(profile);
+    std::cout << os.str() << std::endl;
+
+    std::istringstream is(os.str());
+    std::string line;
+    int lines = 0;
+    while (std::getline(is, line)) {
+        ++lines;
+        std::string::size_type space = line.rfind(' ');
+        BOOST_REQUIRE( space != std::string::npos );
+        std::string count = line.substr(space + 1);
+        BOOST_CHECK( count == "8" || count == "3" );
+        // Outermost frame first
+        std::string::size_type caller = line.find("test_folded_stack_writer");
+        std::string::size_type callee = line.find("recurse_and_resolve");
+        BOOST_CHECK( caller != std::string::npos && callee != std::string::npos && caller < callee );
+        int recursions = 0;
+        for (std::string::size_type pos = callee; pos != std::string::npos; pos = line.find("recurse_and_resolve", pos + 1)) {
+            ++recursions;
+        }
+        BOOST_CHECK( recursions == ((count == "8") ? 4 : 6) );
+    }
+    BOOST_CHECK( lines == 2 );
+
+    // Frames common to both stacks were resolved once
+    BOOST_CHECK( writer.symbols() < s1.depth() + s2.depth() );
+
+    std::ostringstream weights;
+    boost::call_stack::write_folded< boost::call_stack::basic_symbol_resolver >(weights, profile, true);
+    BOOST_CHECK( weights.str().find(" 700\n") != std::string::npos );
+    BOOST_CHECK( weights.str().find(" 300\n") != std::string::npos );
+}
+
+std::string gunzip(const std::string& in)
+{
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    BOOST_REQUIRE( ::inflateInit2(&zs, 15 + 16) == Z_OK );
+    zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    std::string out;
+    char buf[4096];
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        zs.next_out  = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = ::inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    ::inflateEnd(&zs);
+    BOOST_CHECK( ret == Z_STREAM_END );
+    return out;
+#else
+    return in;
+#endif
+}
+
+void test_pprof_writer()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_stack_type s1, s2;
+    recurse_and_resolve(3, s1);
+    recurse_and_resolve(5, s2);
+
+    boost::call_stack::stack_profile< test_stack_type > profile;
+    profile.add(s1, 7, 700);
+    profile.add(s2, 3, 300);
+
+    std::ostringstream os;
+    {
+        boost::call_stack::pprof_writer< boost::call_stack::basic_symbol_resolver > writer(os, "wall", "nanoseconds", 100);
+        writer.add(profile);
+        writer.add(test_stack_type(), 1, 1);    // Skipped
+        // Frames common to both stacks (and recursive calls) have one location
+        BOOST_CHECK( writer.locations() > 0 );
+        BOOST_CHECK( writer.locations() < s2.depth() );
+    }   // finish()
+
+    const std::string gz = os.str();
+#if !defined(BOOST_CALL_STACK_NO_ZLIB)
+    BOOST_REQUIRE( gz.size() > 2 );
+    BOOST_CHECK( static_cast<unsigned char>(gz[0]) == 0x1f && static_cast<unsigned char>(gz[1]) == 0x8b );
+#endif
+    const std::string pb = gunzip(gz);
+    BOOST_CHECK( pb.size() > gz.size() );
+    BOOST_CHECK( pb.find("samples") != std::string::npos );
+    BOOST_CHECK( pb.find("wall") != std::string::npos );
+    BOOST_CHECK( pb.find("recurse_and_resolve") != std::string::npos );
+    BOOST_CHECK( pb.find("test_call_stack") != std::string::npos );   // Mapping
+    // Names are written once
+    BOOST_CHECK( pb.find("test_pprof_writer") == pb.rfind("test_pprof_writer") );
+}
+
+typedef boost::call_stack::trace_recorder< test_stack_type >  test_trace_recorder_type;
+
+__attribute__((noinline)) void traced_work(test_trace_recorder_type& recorder)
+{
+    boost::call_stack::trace_scope< test_stack_type > scope(recorder, "traced_work");
+    recorder.instant("checkpoint \"1\"");
+}
+
+void test_trace_recorder()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_trace_recorder_type recorder(4);
+    traced_work(recorder);
+    boost::thread other(boost::bind(&traced_work, boost::ref(recorder)));
+    other.join();
+    BOOST_CHECK( recorder.size() == 6 );
+    BOOST_CHECK( recorder.dropped() == 0 );
+    // Same call sites from both threads: 2 stacks in the depot, plus the thread's
+    BOOST_CHECK( recorder.depot().size() >= 2 );
+    BOOST_CHECK( recorder.depot().size() <= 4 );
+
+    // Per-thread capacity
+    for (int i = 0; i < 3; ++i) {
+        recorder.instant("overflow", false);
+    }
+    BOOST_CHECK( recorder.size() == 7 );
+    BOOST_CHECK( recorder.dropped() == 2 );
+
+    std::ostringstream os;
+    recorder.write_json< boost::call_stack::basic_symbol_resolver >(os);
+    const std::string json = os.str();
+    std::cout << json.substr(0, 600) << std::endl;
+    BOOST_CHECK( json.find("\"traceEvents\":[") != std::string::npos );
+    BOOST_CHECK( json.find("\"name\":\"traced_work\",\"ph\":\"B\"") != std::string::npos );
+    BOOST_CHECK( json.find("\"ph\":\"E\"") != std::string::npos );
+    BOOST_CHECK( json.find("\"name\":\"checkpoint \\\"1\\\"\",\"ph\":\"i\"") != std::string::npos );
+    BOOST_CHECK( json.find("\"stackFrames\":{") != std::string::npos );
+    BOOST_CHECK( json.find("\"name\":\"traced_work(") != std::string::npos );   // A frame
+    BOOST_CHECK( json.find("\"parent\":\"") != std::string::npos );
+
+    recorder.clear();
+    BOOST_CHECK( recorder.size() == 0 );
+}
+
+__attribute__((noinline)) void* leaky_alloc(std::size_t size, bool array)
+{
+    return array ? static_cast<void*>(new char[size]) : std::malloc(size);
+}
+
+void test_leak_checker()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::basic_leak_checker< test_stack_type >  test_leak_checker_type;
+
+    BOOST_REQUIRE( test_leak_checker_type::start() );
+    BOOST_CHECK( test_leak_checker_type::running() );
+
+    const boost::call_stack::sample_value before = test_leak_checker_type::live();
+    char* p1 = static_cast<char*>(leaky_alloc(1000, true));
+    void* p2 = leaky_alloc(3000, false);
+    void* p3 = leaky_alloc(500, false);
+    p3 = std::realloc(p3, 2000);
+    std::free(p2);
+
+    // A failed realloc() leaves the block, still live
+    void* p4 = std::malloc(64);
+    const boost::call_stack::sample_value kept = test_leak_checker_type::live();
+    volatile std::size_t huge = std::size_t(-1) / 2;
+    BOOST_CHECK( std::realloc(p4, huge) == nullptr );
+    BOOST_CHECK( test_leak_checker_type::live().count == kept.count );
+    std::free(p4);
+
+    test_leak_checker_type::stop();
+    void* untracked = leaky_alloc(100000, false);
+
+    const boost::call_stack::sample_value after = test_leak_checker_type::live();
+    BOOST_CHECK( after.count  >= before.count + 2 );
+    BOOST_CHECK( after.weight >= before.weight + 3000 );
+
+    // The report does not track its own allocations
+    std::ostringstream os;
+    test_leak_checker_type::report< boost::call_stack::basic_symbol_resolver
+                                  , boost::call_stack::terse_call_frame_formatter >(os, 5);
+    BOOST_CHECK( test_leak_checker_type::live().count == after.count );
+    std::cout << os.str() << std::endl;
+    BOOST_CHECK( os.str().find("Live: ") == 0 );
+    BOOST_CHECK( os.str().find("leaky_alloc") != std::string::npos );
+
+    test_leak_checker_type::profile_type profile = test_leak_checker_type::live_profile();
+    boost::uint64_t leaked = weight_of(profile, "leaky_alloc");
+    BOOST_CHECK( leaked == 1000 );   // Not the freed, the realloc()ed nor the untracked
+    BOOST_CHECK( profile.total().weight >= 3000 );
+
+    delete [] p1;
+    std::free(p3);
+    std::free(untracked);
+    profile = test_leak_checker_type::live_profile();
+    BOOST_CHECK( weight_of(profile, "leaky_alloc") == 0 );
+
+    test_leak_checker_type::clear();
+    BOOST_CHECK( test_leak_checker_type::live().count == 0 );
+}
+
+void test_heap_profiler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::basic_heap_profiler< test_stack_type >  test_heap_profiler_type;
+
+    const std::size_t blocks = 20000, size = 1000, expected = blocks * size;
+    std::vector<char*> ptrs;
+    ptrs.reserve(blocks);
+
+    BOOST_REQUIRE( test_heap_profiler_type::start(64 * 1024) );
+    for (std::size_t i = 0; i < blocks; ++i) {
+        ptrs.push_back(static_cast<char*>(leaky_alloc(size, true)));
+    }
+    test_heap_profiler_type::stop();
+
+    // About 300 samples: the estimates are within a few percent
+    const boost::uint64_t inuse     = weight_of(test_heap_profiler_type::inuse_profile(), "leaky_alloc");
+    const boost::uint64_t allocated = weight_of(test_heap_profiler_type::allocated_profile(), "leaky_alloc");
+    std::cout << "Estimated " << inuse << " bytes in use, " << allocated << " allocated, of " << expected << std::endl;
+    BOOST_CHECK( inuse > expected * 7 / 10 && inuse < expected * 13 / 10 );
+    BOOST_CHECK( allocated >= inuse );
+    BOOST_CHECK( test_heap_profiler_type::sampled_blocks() > 0 );
+
+    std::ostringstream os;
+    test_heap_profiler_type::dump< boost::call_stack::basic_symbol_resolver >(os);
+    BOOST_CHECK( gunzip(os.str()).find("inuse_space") != std::string::npos );
+
+    for (std::size_t i = 0; i < ptrs.size(); ++i) {
+        delete [] ptrs[i];
+    }
+    BOOST_CHECK( weight_of(test_heap_profiler_type::inuse_profile(), "leaky_alloc") == 0 );
+    BOOST_CHECK( weight_of(test_heap_profiler_type::allocated_profile(), "leaky_alloc") == allocated );
+
+    test_heap_profiler_type::clear();
+    BOOST_CHECK( test_heap_profiler_type::allocated_profile().empty() );
+}
+
+typedef boost::call_stack::basic_contention_profiler< test_stack_type >              test_contention_profiler_type;
+typedef boost::call_stack::basic_profiled_mutex< boost::mutex, test_stack_type >     test_profiled_mutex_type;
+
+static boost::atomic<bool> sg_contended_held(false);
+
+__attribute__((noinline)) void contended_holder(test_profiled_mutex_type& mutex)
+{
+    boost::lock_guard<test_profiled_mutex_type> lock(mutex);
+    sg_contended_held = true;
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+}
+
+__attribute__((noinline)) void contended_waiter(test_profiled_mutex_type& mutex)
+{
+    boost::lock_guard<test_profiled_mutex_type> lock(mutex);
+}
+
+void test_contention_profiler()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_profiled_mutex_type mutex;
+    test_contention_profiler_type::start(10 * 1000000, 0);
+
+    for (int i = 0; i < 10; ++i) {
+        contended_waiter(mutex);   // Uncontended
+    }
+    boost::thread holder(contended_holder, boost::ref(mutex));
+    while (!sg_contended_held) {
+        boost::this_thread::yield();
+    }
+    contended_waiter(mutex);
+    holder.join();
+    test_contention_profiler_type::stop();
+
+    const test_contention_profiler_type::stats_type stats = test_contention_profiler_type::stats();
+    BOOST_CHECK( stats.acquisitions == 12 );
+    BOOST_CHECK( stats.contended == 1 );
+    BOOST_CHECK( stats.wait_ns >= 50 * 1000000ull );
+    BOOST_CHECK( stats.hold_ns + 10 * 1000000ull >= stats.wait_ns );   // The waiter wakes up after the release
+
+    const boost::uint64_t waited  = weight_of(test_contention_profiler_type::waiter_profile(), "contended_waiter");
+    const boost::uint64_t blocked = weight_of(test_contention_profiler_type::holder_profile(), "contended_holder");
+    std::cout << "Waited " << waited << " ns, blocked by holder " << blocked << " ns" << std::endl;
+    BOOST_CHECK( waited == stats.wait_ns );
+    BOOST_CHECK( blocked >= 50 * 1000000ull && blocked <= waited + 1000000 );
+
+    test_contention_profiler_type::clear();
+    BOOST_CHECK( test_contention_profiler_type::waiter_profile().empty() );
+    BOOST_CHECK( test_contention_profiler_type::stats().acquisitions == 0 );
+}
+
+typedef boost::call_stack::basic_throw_tracer< test_stack_type >  test_throw_tracer_type;
+
+__attribute__((noinline)) int throwing_at(const std::vector<int>& v)
+{
+    return v.at(v.size());   // std::out_of_range, thrown by libstdc++
+}
+
+__attribute__((noinline)) void throwing_user(int i)
+{
+    throw std::runtime_error(i % 2 ? "odd" : "even");
+}
+
+bool stack_has(const test_stack_type& stk, const char* function)
+{
+    return boost::call_stack::call_stack_info< test_stack_type
+                                             , boost::call_stack::basic_symbol_resolver
+                                             , boost::call_stack::terse_call_frame_formatter
+                                             >(stk).as_string().find(function) != std::string::npos;
+}
+
+void test_throw_tracer()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    BOOST_REQUIRE( test_throw_tracer_type::enable() );
+
+    test_stack_type stk;
+    std::vector<int> v(3);
+    try {
+        throwing_at(v);
+        BOOST_CHECK( false );
+    }
+    catch (const std::out_of_range&) {
+        BOOST_CHECK( test_throw_tracer_type::current(stk) );
+        // The return address past the noreturn call might be in the next function
+        BOOST_CHECK( stack_has(stk, "test_throw_tracer") );
+    }
+
+    try {
+        throwing_user(1);
+    }
+    catch (const std::runtime_error& ex) {
+        stk = test_stack_type();
+        BOOST_CHECK( test_throw_tracer_type::where(&ex, stk) );
+        BOOST_CHECK( stack_has(stk, "throwing_user") );
+    }
+
+    // Rethrown: same object, same stack
+    try {
+        try {
+            throwing_user(2);
+        }
+        catch (...) {
+            throw;
+        }
+    }
+    catch (const std::exception&) {
+        stk = test_stack_type();
+        BOOST_CHECK( test_throw_tracer_type::current(stk) && stack_has(stk, "throwing_user") );
+    }
+
+    // One in 4 throws
+    BOOST_REQUIRE( test_throw_tracer_type::enable(4) );
+    const boost::uint64_t captured = test_throw_tracer_type::captured();
+    int found = 0;
+    for (int i = 0; i < 40; ++i) {
+        try {
+            throwing_user(i);
+        }
+        catch (const std::exception&) {
+            found += test_throw_tracer_type::current(stk) ? 1 : 0;
+        }
+    }
+    BOOST_CHECK( test_throw_tracer_type::captured() - captured == 10 );
+    BOOST_CHECK( found == 10 );
+
+    test_throw_tracer_type::disable();
+    try {
+        throwing_user(0);
+    }
+    catch (const std::exception&) {
+        BOOST_CHECK( !test_throw_tracer_type::current(stk) );
+    }
+}
+
+typedef boost::call_stack::flight_recorder< test_stack_type >  test_flight_recorder_type;
+
+__attribute__((noinline)) void flight_events(test_flight_recorder_type& recorder, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        recorder.record("event", i);
+    }
+}
+
+void test_flight_recorder()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_flight_recorder_type recorder(16);
+    flight_events(recorder, 40);
+    boost::thread other(flight_events, boost::ref(recorder), 5);
+    other.join();   // Its events outlive it
+
+    typedef std::map< boost::call_stack::detail::thread_id_type
+                    , std::vector<test_flight_recorder_type::event_type> >  threads_type;
+    const threads_type threads = recorder.events();
+    BOOST_REQUIRE( threads.size() == 2 );
+
+    const std::vector<test_flight_recorder_type::event_type>& mine =
+        threads.find(boost::call_stack::detail::current_thread_id())->second;
+    BOOST_REQUIRE( mine.size() == 16 );
+    BOOST_CHECK( mine.front().value == 24 && mine.back().value == 39 );
+    BOOST_CHECK( mine.front().ticks <= mine.back().ticks );
+    BOOST_CHECK( stack_has(mine.back().stack, "flight_events") );
+
+    std::ostringstream os;
+    recorder.dump< boost::call_stack::basic_symbol_resolver
+                 , boost::call_stack::terse_call_frame_formatter >(os);
+    std::cout << os.str().substr(0, 1000) << std::endl;
+    BOOST_CHECK( os.str().find(": 16 events") != std::string::npos );
+    BOOST_CHECK( os.str().find(": 5 events") != std::string::npos );
+    BOOST_CHECK( os.str().find("] event 39") != std::string::npos );
+}
+
+typedef boost::call_stack::stack_profile< test_stack_type >  test_profile_type;
+
+__attribute__((noinline)) void sampled_path(test_profile_type& profile)
+{
+    BOOST_CALL_STACK_CAPTURE_EVERY(profile, 10);
+}
+
+__attribute__((noinline)) void limited_path(test_profile_type& profile)
+{
+    BOOST_CALL_STACK_CAPTURE_LIMITED(profile, 2, 5);
+}
+
+void test_sampled_capture()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_profile_type sampled;
+    for (int i = 0; i < 1000; ++i) {
+        sampled_path(sampled);
+    }
+    BOOST_CHECK( sampled.size() == 1 );
+    BOOST_CHECK( sampled.total().count == 100 );
+    BOOST_CHECK( sampled.total().weight == 1000 );
+    BOOST_CHECK( weight_of(sampled, "sampled_path") == 1000 );
+
+    // 5 a second, unless the loop straddles a second
+    test_profile_type limited;
+    for (int i = 0; i < 1000; ++i) {
+        limited_path(limited);
+    }
+    BOOST_CHECK( limited.total().count >= 5 && limited.total().count <= 10 );
+    BOOST_CHECK( limited.total().weight == 2 * limited.total().count );
+}
+
+typedef boost::call_stack::stack_histogram< test_stack_type >  test_histogram_type;
+
+__attribute__((noinline)) void histogram_worker(test_histogram_type& histogram, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        histogram.capture(1, 10);
+        if (i % 4 == 0) {
+            BOOST_CALL_STACK_CAPTURE_EVERY(histogram, 2);
+        }
+    }
+}
+
+void test_stack_histogram()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_histogram_type histogram;
+    boost::thread_group workers;
+    for (int i = 0; i < 4; ++i) {
+        workers.create_thread(boost::bind(histogram_worker, boost::ref(histogram), 1000));
+    }
+    workers.join_all();
+
+    // Two call sites, the thread entry point the same for all
+    BOOST_CHECK( histogram.size() == 2 );
+    test_profile_type profile = histogram.snapshot();
+    BOOST_CHECK( profile.total().count == 4 * 1000 + 4 * 125 );
+    BOOST_CHECK( profile.total().weight == 4 * 1000 * 10 + 4 * 250 );
+    BOOST_CHECK( weight_of(profile, "histogram_worker") == profile.total().weight );
+    BOOST_CHECK( histogram.value(profile.sorted().front().first).count == 4000 );
+
+    profile = histogram.take();
+    BOOST_CHECK( profile.total().count == 4500 );
+    BOOST_CHECK( histogram.empty() );
+    BOOST_CHECK( histogram.take().empty() );
+}
+
+typedef boost::call_stack::call_graph< boost::call_stack::basic_symbol_resolver >  test_call_graph_type;
+
+__attribute__((noinline)) void graph_leaf(test_call_graph_type& graph, int weight)
+{
+    test_stack_type stk(true);
+    graph.add(stk, 1, weight);
+    __asm__ __volatile__("");
+}
+
+__attribute__((noinline)) void graph_recurse(test_call_graph_type& graph, int depth)
+{
+    if (depth) {
+        graph_recurse(graph, depth - 1);
+    }
+    else {
+        graph_leaf(graph, 100);
+    }
+    __asm__ __volatile__("");
+}
+
+__attribute__((noinline)) void graph_top(test_call_graph_type& graph)
+{
+    graph_leaf(graph, 1);
+    graph_recurse(graph, 3);
+    __asm__ __volatile__("");
+}
+
+test_call_graph_type::function_id graph_function(const test_call_graph_type& graph, const char* name)
+{
+    for (std::size_t i = 0; i < graph.functions().size(); ++i) {
+        if (graph.functions()[i].name.find(name) == 0) {
+            return i;
+        }
+    }
+    return graph.functions().size();
+}
+
+void test_call_graph()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_call_graph_type graph;
+    graph_top(graph);
+
+    const test_call_graph_type::function_id top     = graph_function(graph, "graph_top(");
+    const test_call_graph_type::function_id recurse = graph_function(graph, "graph_recurse(");
+    const test_call_graph_type::function_id leaf    = graph_function(graph, "graph_leaf(");
+    BOOST_REQUIRE( top < graph.functions().size() && recurse < graph.functions().size() && leaf < graph.functions().size() );
+
+    // Both samples are in the leaf, called from both top and recurse
+    BOOST_CHECK( graph.functions()[leaf].total.count == 2 );
+    BOOST_CHECK( graph.functions()[top].total.weight == 101 );
+    BOOST_CHECK( graph.functions()[top].self.count == 0 );
+    BOOST_CHECK( graph.functions()[recurse].total.weight == 100 );   // Once, recursion notwithstanding
+    BOOST_CHECK( graph.edge(top, leaf).weight == 1 );
+    BOOST_CHECK( graph.edge(top, recurse).weight == 100 );
+    BOOST_CHECK( graph.edge(recurse, recurse).count == 1 );
+    BOOST_CHECK( graph.edge(recurse, leaf).weight == 100 );
+    BOOST_CHECK( graph.edge(leaf, top).count == 0 );
+
+    std::ostringstream os;
+    graph.write(os, true);
+    std::cout << os.str().substr(0, 1500) << std::endl;
+    BOOST_CHECK( os.str().find("  -> graph_recurse(") != std::string::npos );
+    BOOST_CHECK( os.str().find("  <- graph_top(") != std::string::npos );
+}
+
+__attribute__((noinline)) void slow_request(test_histogram_type& slow, int ms)
+{
+    BOOST_CALL_STACK_LATENCY_GUARD(slow, 20 * 1000000ull);
+    if (ms) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+    }
+}
+
+void test_latency_guard()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_histogram_type slow;
+    for (int i = 0; i < 100; ++i) {
+        slow_request(slow, 0);
+    }
+    BOOST_CHECK( slow.empty() );
+
+    slow_request(slow, 40);
+    const test_profile_type profile = slow.snapshot();
+    BOOST_CHECK( profile.total().count == 1 );
+    BOOST_CHECK( profile.total().weight >= 40 * 1000000ull );
+    BOOST_CHECK( weight_of(profile, "slow_request") == profile.total().weight );
+}
+
+
+typedef boost::call_stack::basic_stall_watchdog< test_stack_type >  test_stall_watchdog_type;
+
+__attribute__((noinline)) void stalling_work(int ms)
+{
+    boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+}
+
+void stalling_loop(test_stall_watchdog_type* watchdog)
+{
+    test_stall_watchdog_type::heartbeat& hb = watchdog->watch();
+    for (int i = 0; i < 20; ++i) {
+        hb.beat();
+        stalling_work(1);
+    }
+    hb.beat();
+    stalling_work(150);     // Stall
+    hb.beat();
+    hb.idle();
+    stalling_work(150);     // Legitimate wait
+    hb.beat();
+    watchdog->unwatch(hb);
+}
+
+boost::atomic<bool> sg_unblock(false);
+
+__attribute__((noinline)) void blocked_wait()
+{
+    while (!sg_unblock) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+void blocked_loop(test_stall_watchdog_type* watchdog)
+{
+    test_stall_watchdog_type::heartbeat& hb = watchdog->watch();
+    hb.beat();
+    blocked_wait();         // Stalled until the test lets it go
+    watchdog->unwatch(hb);
+}
+
+boost::atomic<int> stalls_handled(0);
+boost::atomic<std::size_t> stalls_seen(0);
+test_stall_watchdog_type* sg_watchdog = nullptr;
+
+void count_stall(const test_stall_watchdog_type::stall_type&)
+{
+    ++stalls_handled;
+    stalls_seen = sg_watchdog->stalls().size(); // Not under the watchdog's lock
+}
+
+void test_stall_watchdog()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_stall_watchdog_type watchdog(40, 10);
+    sg_watchdog = &watchdog;
+    watchdog.on_stall(&count_stall);
+    BOOST_CHECK( watchdog.start() );
+
+    boost::thread worker(&stalling_loop, &watchdog);
+    worker.join();
+    watchdog.stop();
+
+    const std::vector<test_stall_watchdog_type::stall_type> stalls = watchdog.take_stalls();
+    BOOST_CHECK( stalls.size() == 1 );
+    BOOST_CHECK( stalls_handled == 1 );
+    BOOST_CHECK( stalls_seen == 1 );
+    BOOST_CHECK( watchdog.stalls().empty() );
+    if (!stalls.empty()) {
+        BOOST_CHECK( stalls[0].duration_ns >= 100 * 1000000ull );
+        BOOST_CHECK( !stalls[0].stacks.empty() );
+        bool found = false;
+        for (std::size_t i = 0; i < stalls[0].stacks.size(); ++i) {
+            found = found || stack_has(stalls[0].stacks[i], "stalling_work");
+        }
+        BOOST_CHECK( found );
+
+        std::ostringstream os;
+        test_stall_watchdog_type::write< boost::call_stack::basic_symbol_resolver
+                                       , boost::call_stack::terse_call_frame_formatter >(os, stalls[0]);
+        std::cout << os.str().substr(0, 1500) << std::endl;
+        BOOST_CHECK( os.str().find("stalling_work") != std::string::npos );
+    }
+
+    // A thread that does not beat again: seen while it is stalled
+    test_stall_watchdog_type blocked_watchdog(40, 10);
+    BOOST_CHECK( blocked_watchdog.start() );
+    boost::thread blocked(&blocked_loop, &blocked_watchdog);
+    std::vector<test_stall_watchdog_type::stall_type> ongoing;
+    for (int i = 0; i < 2000; ++i) {
+        ongoing = blocked_watchdog.ongoing_stalls();
+        if (!ongoing.empty() && ongoing[0].stacks.size() >= 2)
+            break;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    BOOST_CHECK( ongoing.size() == 1 );
+    BOOST_CHECK( blocked_watchdog.stalls().empty() );
+    if (!ongoing.empty()) {
+        BOOST_CHECK( ongoing[0].duration_ns >= 40 * 1000000ull );
+        BOOST_CHECK( ongoing[0].stacks.size() >= 2 );
+        BOOST_CHECK( !ongoing[0].stacks.empty() && stack_has(ongoing[0].stacks.back(), "blocked_wait") );
+    }
+    sg_unblock = true;
+    blocked.join();
+    blocked_watchdog.stop();
+    BOOST_CHECK( blocked_watchdog.ongoing_stalls().empty() );
+    BOOST_CHECK( blocked_watchdog.stalls().size() == 1 );
+}
+
+
+typedef boost::call_stack::basic_lock_order_checker< test_stack_type >              test_lock_order_type;
+typedef boost::call_stack::basic_checked_mutex< boost::mutex, test_stack_type >     test_checked_mutex_type;
+
+__attribute__((noinline)) void lock_in_order(test_checked_mutex_type& first, test_checked_mutex_type& second)
+{
+    boost::lock_guard<test_checked_mutex_type> one(first);
+    boost::lock_guard<test_checked_mutex_type> two(second);
+}
+
+bool cycle_has(const test_lock_order_type::violation_type& violation, const char* function)
+{
+    for (std::size_t i = 0; i < violation.cycle.size(); ++i) {
+        if (!stack_has(test_lock_order_type::stack(violation.cycle[i].stack_id), function)) {
+            return false;
+        }
+    }
+    return !violation.cycle.empty();
+}
+
+void test_lock_order()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    test_checked_mutex_type a, b, c;
+    test_lock_order_type::clear();
+    test_lock_order_type::start();
+
+    // Consistent order
+    for (int i = 0; i < 100; ++i) {
+        lock_in_order(a, b);
+        lock_in_order(b, c);
+    }
+    BOOST_CHECK( test_lock_order_type::violations().empty() );
+    BOOST_CHECK( test_lock_order_type::stats().acquisitions == 400 );
+    BOOST_CHECK( test_lock_order_type::stats().edges == 2 );
+
+    // Not held anymore
+    {
+        boost::lock_guard<test_checked_mutex_type> one(c);
+    }
+    lock_in_order(c, b);     // Inversion, from another thread
+    boost::thread inverted(boost::bind(&lock_in_order, boost::ref(c), boost::ref(a)));
+    inverted.join();
+
+    const std::vector<test_lock_order_type::violation_type> violations = test_lock_order_type::violations();
+    BOOST_CHECK( violations.size() == 2 );
+    if (violations.size() == 2) {
+        BOOST_CHECK( violations[0].cycle.size() == 2 );
+        BOOST_CHECK( violations[0].cycle[0].from == c.id() && violations[0].cycle[0].to == b.id() );
+        BOOST_CHECK( violations[0].cycle[1].from == b.id() && violations[0].cycle[1].to == c.id() );
+        BOOST_CHECK( violations[1].cycle.size() == 3 );   // c -> a -> b -> c
+        BOOST_CHECK( violations[1].cycle[0].tid != violations[1].cycle[1].tid );
+        BOOST_CHECK( cycle_has(violations[1], "lock_in_order") );
+
+        std::ostringstream os;
+        test_lock_order_type::write< boost::call_stack::basic_symbol_resolver
+                                   , boost::call_stack::terse_call_frame_formatter >(os, violations[1]);
+        std::cout << os.str().substr(0, 2500) << std::endl;
+        BOOST_CHECK( os.str().find("cycle of 3 locks") != std::string::npos );
+    }
+
+    // Reported once
+    lock_in_order(c, b);
+    BOOST_CHECK( test_lock_order_type::stats().violations == 2 );
+
+    test_lock_order_type::stop();
+    lock_in_order(a, c);
+    BOOST_CHECK( test_lock_order_type::stats().edges == 4 );   // Not checked
+}
+
+
+struct tracked_session : public boost::call_stack::tracked_instance< tracked_session, test_stack_type >
+{
+    char payload[40];
+};
+
+typedef tracked_session::tracker_type  test_instance_tracker_type;
+
+__attribute__((noinline)) void make_sessions(std::vector<tracked_session*>& out, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        out.push_back(new tracked_session());
+    }
+}
+
+__attribute__((noinline)) void copy_sessions(std::vector<tracked_session>& out, int count)
+{
+    tracked_session proto;
+    out.assign(count, proto);
+}
+
+boost::uint64_t count_of(const test_profile_type& profile, const char* function)
+{
+    boost::uint64_t ret = 0;
+    for (test_profile_type::const_iterator it = profile.begin(); it != profile.end(); ++it) {
+        if (stack_has(it->first, function)) {
+            ret += it->second.count;
+        }
+    }
+    return ret;
+}
+
+void test_instance_tracker()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    BOOST_CHECK( test_instance_tracker_type::live() == 0 );
+
+    std::vector<tracked_session*> made;
+    make_sessions(made, 300);
+    std::vector<tracked_session> copies;
+    copy_sessions(copies, 200);
+    BOOST_CHECK( test_instance_tracker_type::live() == 500 );
+
+    test_profile_type profile = test_instance_tracker_type::live_profile();
+    BOOST_CHECK( profile.total().count == 500 );
+    BOOST_CHECK( profile.total().weight == 500 * sizeof(tracked_session) );
+    BOOST_CHECK( count_of(profile, "make_sessions") == 300 );
+    BOOST_CHECK( count_of(profile, "copy_sessions") == 200 );
+
+    std::ostringstream os;
+    test_instance_tracker_type::report< boost::call_stack::basic_symbol_resolver
+                                      , boost::call_stack::terse_call_frame_formatter >(os, 2);
+    std::cout << os.str().substr(0, 1500) << std::endl;
+    BOOST_CHECK( os.str().find("300 instances") != std::string::npos );
+
+    for (std::size_t i = 0; i < made.size(); i += 2) {
+        delete made[i];
+    }
+    copies.clear();
+    BOOST_CHECK( test_instance_tracker_type::live() == 150 );
+    BOOST_CHECK( test_instance_tracker_type::live_profile().total().count == 150 );
+    for (std::size_t i = 1; i < made.size(); i += 2) {
+        delete made[i];
+    }
+    made.clear();
+    BOOST_CHECK( test_instance_tracker_type::live() == 0 );
+    BOOST_CHECK( test_instance_tracker_type::live_profile().empty() );
+
+    // Sampled: estimated counts
+    test_instance_tracker_type::set_sample_every(10);
+    make_sessions(made, 1000);
+    BOOST_CHECK( test_instance_tracker_type::live() == 1000 );
+    profile = test_instance_tracker_type::live_profile();
+    BOOST_CHECK( profile.total().count >= 990 && profile.total().count <= 1010 );
+    BOOST_CHECK( profile.size() == 1 );
+    for (std::size_t i = 0; i < made.size(); ++i) {
+        delete made[i];
+    }
+    BOOST_CHECK( test_instance_tracker_type::live_profile().empty() );
+    test_instance_tracker_type::set_sample_every(1);
+}
+
+
+typedef boost::call_stack::basic_resource_tracker< test_stack_type >  test_resource_tracker_type;
+
+__attribute__((noinline)) int leaky_open()
+{
+    return ::open("/dev/null", O_RDONLY);
+}
+
+__attribute__((noinline)) int leaky_socket()
+{
+    return ::socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+void* idle_thread(void*)
+{
+    return nullptr;
+}
+
+__attribute__((noinline)) pthread_t leaky_thread()
+{
+    pthread_t thread;
+    ::pthread_create(&thread, nullptr, &idle_thread, nullptr);
+    return thread;
+}
+
+boost::atomic<int> sg_self_join(-1);
+
+void* self_joining_thread(void*)
+{
+    sg_self_join = ::pthread_join(::pthread_self(), nullptr);
+    return nullptr;
+}
+
+__attribute__((noinline)) pthread_t leaky_self_joiner()
+{
+    pthread_t thread;
+    ::pthread_create(&thread, nullptr, &self_joining_thread, nullptr);
+    return thread;
+}
+
+void test_resource_tracker()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    BOOST_CHECK( test_resource_tracker_type::start() );
+
+    const int fd1 = leaky_open();
+    const int fd2 = leaky_open();
+    const int fd3 = leaky_socket();
+    const int fd4 = ::dup(fd3);
+    BOOST_CHECK( fd1 >= 0 && fd2 >= 0 && fd3 >= 0 && fd4 >= 0 );
+    ::close(fd1);
+    BOOST_CHECK( test_resource_tracker_type::fd_stack(fd1).empty() );
+    BOOST_CHECK( stack_has(test_resource_tracker_type::fd_stack(fd2), "leaky_open") );
+
+    const pthread_t joined = leaky_thread();
+    const pthread_t leaked = leaky_thread();
+    ::pthread_join(joined, nullptr);
+
+    test_profile_type fds = test_resource_tracker_type::fd_profile();
+    BOOST_CHECK( count_of(fds, "leaky_open") == 1 );
+    BOOST_CHECK( count_of(fds, "leaky_socket") == 1 );
+    BOOST_CHECK( count_of(fds, "test_resource_tracker") == 3 );   // dup() too
+    test_profile_type threads = test_resource_tracker_type::thread_profile();
+    BOOST_CHECK( count_of(threads, "leaky_thread") == 1 );
+
+    // A join that fails keeps the record
+    const pthread_t self_joiner = leaky_self_joiner();
+    while (sg_self_join < 0) {
+        boost::this_thread::yield();
+    }
+    BOOST_CHECK( sg_self_join == EDEADLK );
+    BOOST_CHECK( count_of(test_resource_tracker_type::thread_profile(), "leaky_self_joiner") == 1 );
+    ::pthread_join(self_joiner, nullptr);
+    BOOST_CHECK( count_of(test_resource_tracker_type::thread_profile(), "leaky_self_joiner") == 0 );
+
+    std::ostringstream os;
+    test_resource_tracker_type::report< boost::call_stack::basic_symbol_resolver
+                                      , boost::call_stack::terse_call_frame_formatter >(os, 3);
+    std::cout << os.str().substr(0, 2500) << std::endl;
+    BOOST_CHECK( os.str().find("leaky_thread") != std::string::npos );
+
+    test_resource_tracker_type::stop();
+    ::close(fd2);
+    ::close(fd3);
+    ::close(fd4);
+    ::pthread_join(leaked, nullptr);
+    BOOST_CHECK( count_of(test_resource_tracker_type::fd_profile(), "test_resource_tracker") == 0 );
+    BOOST_CHECK( test_resource_tracker_type::thread_profile().empty() );
+}
+
+
+__attribute__((noinline)) void shadow_outer() { asm(""); }
+__attribute__((noinline)) void shadow_inner() { asm(""); }
+
+void test_shadow_stack()
+{
+    std::cout << "\n*\n* " << __FUNCTION__ << "\n*\n" << std::endl;
+
+    typedef boost::call_stack::shadow_stack  shadow;
+    void* const outer = reinterpret_cast<void*>(&shadow_outer);
+    void* const inner = reinterpret_cast<void*>(&shadow_inner);
+
+    // The test is not built with -finstrument-functions: play the compiler
+    BOOST_CHECK( shadow::defined() );
+    const std::size_t base = shadow::depth();
+    __cyg_profile_func_enter(outer, nullptr);
+    __cyg_profile_func_enter(inner, nullptr);
+    BOOST_CHECK( shadow::depth() == base + 2 );
+
+    test_stack_type stk;
+    BOOST_CHECK( shadow::get_stack(stk) == base + 2 );
+    BOOST_CHECK( stk.size() >= 2 && stk[0].addr() == inner && stk[1].addr() == outer );
+    BOOST_CHECK( stack_has(stk, "shadow_inner") );
+
+    __cyg_profile_func_exit(inner, nullptr);
+    BOOST_CHECK( shadow::get_stack(stk) == base + 1 && stk[0].addr() == outer );
+
+    // Frames skipped, as by longjmp()
+    __cyg_profile_func_enter(inner, nullptr);
+    __cyg_profile_func_enter(inner, nullptr);
+    __cyg_profile_func_exit(outer, nullptr);
+    BOOST_CHECK( shadow::depth() == base );
+
+    // Deeper than the capacity: the innermost frames are kept, the
+    // outermost overwritten
+    for (std::size_t i = 0; i < shadow::capacity + 10; ++i) {
+        __cyg_profile_func_enter(i % 2 ? inner : outer, nullptr);
+    }
+    __cyg_profile_func_enter(outer, nullptr);
+    __cyg_profile_func_enter(outer, nullptr);
+    __cyg_profile_func_enter(inner, nullptr);
+    BOOST_CHECK( shadow::depth() == base + shadow::capacity + 13 );
+    BOOST_CHECK( shadow::get_stack(stk) == stk.max_depth() );
+    BOOST_CHECK( stk[0].addr() == inner && stk[1].addr() == outer && stk[2].addr() == outer && stk[3].addr() == inner );
+
+    void* kept[shadow::capacity + 20];
+    BOOST_CHECK( boost::call_stack::detail::shadow_stack_hooks::get_frames(kept, shadow::capacity + 20) == shadow::capacity );
+    BOOST_CHECK( kept[0] == inner && kept[shadow::capacity - 1] == inner ); // The 14th entered
+
+    // Too deep for a call stack with room for all: unwinds instead
+    boost::array< boost::call_stack::detail::call_frame_impl, shadow::capacity + 20 > frames;
+    BOOST_CHECK( boost::call_stack::detail::shadow_stack_hooks::get_stack(frames) == 0 );
+
+    __cyg_profile_func_exit(inner, nullptr);
+    __cyg_profile_func_exit(outer, nullptr);
+    __cyg_profile_func_exit(outer, nullptr);
+    for (std::size_t i = 0; i < shadow::capacity + 10; ++i) {
+        __cyg_profile_func_exit(i % 2 ? outer : inner, nullptr);
+    }
+    BOOST_CHECK( shadow::depth() == base );
+}
+
 
 void test_symbol()
 {
@@ -407,6 +1924,31 @@ boost::unit_test::test_suite* init_unit_test_suite(int, char*[])
     tests->add(BOOST_TEST_CASE(test_call_frame_info));
     tests->add(BOOST_TEST_CASE(test_call_stack));
     tests->add(BOOST_TEST_CASE(test_call_stack_info));
+    tests->add(BOOST_TEST_CASE(test_resolved_call_stack_info));
+    tests->add(BOOST_TEST_CASE(test_output_buffer));
+    tests->add(BOOST_TEST_CASE(test_crash_handler));
+    tests->add(BOOST_TEST_CASE(test_context_stack));
+    tests->add(BOOST_TEST_CASE(test_thread_dump));
+    tests->add(BOOST_TEST_CASE(test_cpu_profiler));
+    tests->add(BOOST_TEST_CASE(test_wall_profiler));
+    tests->add(BOOST_TEST_CASE(test_perf_profiler));
+    tests->add(BOOST_TEST_CASE(test_folded_stack_writer));
+    tests->add(BOOST_TEST_CASE(test_pprof_writer));
+    tests->add(BOOST_TEST_CASE(test_trace_recorder));
+    tests->add(BOOST_TEST_CASE(test_leak_checker));
+    tests->add(BOOST_TEST_CASE(test_heap_profiler));
+    tests->add(BOOST_TEST_CASE(test_contention_profiler));
+    tests->add(BOOST_TEST_CASE(test_throw_tracer));
+    tests->add(BOOST_TEST_CASE(test_flight_recorder));
+    tests->add(BOOST_TEST_CASE(test_sampled_capture));
+    tests->add(BOOST_TEST_CASE(test_stack_histogram));
+    tests->add(BOOST_TEST_CASE(test_call_graph));
+    tests->add(BOOST_TEST_CASE(test_latency_guard));
+    tests->add(BOOST_TEST_CASE(test_stall_watchdog));
+    tests->add(BOOST_TEST_CASE(test_lock_order));
+    tests->add(BOOST_TEST_CASE(test_instance_tracker));
+    tests->add(BOOST_TEST_CASE(test_resource_tracker));
+    tests->add(BOOST_TEST_CASE(test_shadow_stack));
 
     tests->add(BOOST_TEST_CASE(test_end));
 